@@ -0,0 +1,162 @@
+// Micro-benchmark for the curve kernels in curves.cpp. Needs no window or GPU.
+//
+// Build:  cmake -S . -B build && cmake --build build --target curvebench
+// Usage:  ./curvebench [max control points, default 1000000]
+//
+// Sweeps the control polygon size by powers of ten from 10 and reports, for
+// each scheme, the time per input control point and control points per second.
+// The SoA subdivision and Bezier kernels are run at every SIMD level the CPU
+// supports, with their speedup over the Vertex (AoS) version. The basis-table
+// Catmull-Rom evaluators are compared against de Casteljau.
+//
+// Each faster kernel is also checked against the one it replaces: the largest
+// difference in x or y over all its points is printed, and the exit status is 1
+// if any is over MaxDiff.
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include <math.h>
+
+#include "curves.hpp"
+
+#define PI 3.1415926535897
+
+float benchColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+// closed polygon of n points on a wobbly circle, so no two neighbours coincide
+void makePolygon(std::vector<Vertex>& p, int n) {
+	p.resize(n);
+	for (int i = 0; i < n; i++) {
+		float a = 2.0f * float(PI) * i / n;
+		float r = 1.0f + 0.25f * sinf(7.0f * a);
+		float coords[] = { r * cosf(a), r * sinf(a), 0.0f, 1.0f };
+		p[i].SetCoords(coords);
+		p[i].SetColor(benchColor);
+	}
+}
+
+double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// keeps the optimiser from dropping the kernel calls
+volatile float sink;
+
+// the polygon's coordinates are around 1, so this leaves room for a few float roundings
+const float MaxDiff = 1e-5f;
+bool failed = false;
+
+// largest difference in x or y between the reference points and a kernel's SoA output
+float diffSoA(const Vertex* ref, const float* x, const float* y, int count) {
+	float diff = 0.0f;
+	for (int i = 0; i < count; i++) {
+		diff = fmaxf(diff, fabsf(ref[i].XYZW[0] - x[i]));
+		diff = fmaxf(diff, fabsf(ref[i].XYZW[1] - y[i]));
+	}
+	return diff;
+}
+
+// the same against a kernel's Vertex output
+float diffAoS(const Vertex* ref, const Vertex* out, int count) {
+	float diff = 0.0f;
+	for (int i = 0; i < count; i++) {
+		diff = fmaxf(diff, fabsf(ref[i].XYZW[0] - out[i].XYZW[0]));
+		diff = fmaxf(diff, fabsf(ref[i].XYZW[1] - out[i].XYZW[1]));
+	}
+	return diff;
+}
+
+// run kernel until at least minTime has passed, return seconds per call
+template <typename F>
+double timeKernel(F kernel, const Vertex* out, double minTime) {
+	int reps = 0;
+	double start = now();
+	double elapsed = 0.0;
+	do {
+		kernel();
+		sink = out[0].XYZW[0];
+		reps++;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	return elapsed / reps;
+}
+
+// diff < 0 for a kernel that is the reference itself
+void report(const char* scheme, int n, double seconds, double baseline = 0.0, float diff = -1.0f) {
+	printf("%-18s %10d %12.3f %14.0f", scheme, n, seconds * 1e9 / n, n / seconds);
+	if (baseline > 0.0) {
+		printf(" %8.2fx", baseline / seconds);
+	}
+	if (diff >= 0.0f) {
+		printf(" %10.2e%s", diff, diff > MaxDiff ? " FAIL" : "");
+		failed = failed || diff > MaxDiff;
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	int maxPoints = 1000000;
+	if (argc > 1) {
+		maxPoints = atoi(argv[1]);
+	}
+	const double minTime = 0.2;
+
+	std::vector<Vertex> poly;
+	std::vector<Vertex> out;
+	std::vector<Vertex> bez;
+	std::vector<Vertex> ref;
+	std::vector<float> px, py, cx, cy;
+	char name[32];
+
+	printf("%-18s %10s %12s %14s %9s %10s\n", "scheme", "points", "ns/point", "points/s", "speedup", "max diff");
+	for (int n = 10; n <= maxPoints; n *= 10) {
+		makePolygon(poly, n);
+
+		px.resize(n);
+		py.resize(n);
+		VerticesToSoA(&px[0], &py[0], &poly[0], n);
+		cx.resize(4 * n);
+		cy.resize(4 * n);
+
+		out.resize(2 * n);
+		double aos = timeKernel([&] { Subdivision(&out[0], &poly[0], n, benchColor); }, &out[0], minTime);
+		report("subdivision", n, aos);
+		for (int level = SimdScalar; level <= SimdDetect(); level++) {
+			SetSimdLevel((SimdLevel)level);
+			sprintf(name, "subdivision-%s", SimdLevelName((SimdLevel)level));
+			double seconds = timeKernel([&] { SubdivisionSoA(&cx[0], &cy[0], &px[0], &py[0], n); }, &out[0], minTime);
+			report(name, n, seconds, aos, diffSoA(&out[0], &cx[0], &cy[0], 2 * n));
+		}
+
+		out.resize(4 * n);
+		aos = timeKernel([&] { BezierCurves(&poly[0], &out[0], n, benchColor); }, &out[0], minTime);
+		report("bezier", n, aos);
+		for (int level = SimdScalar; level <= SimdDetect(); level++) {
+			SetSimdLevel((SimdLevel)level);
+			sprintf(name, "bezier-%s", SimdLevelName((SimdLevel)level));
+			double seconds = timeKernel([&] { BezierCurvesSoA(&cx[0], &cy[0], &px[0], &py[0], n); }, &out[0], minTime);
+			report(name, n, seconds, aos, diffSoA(&out[0], &cx[0], &cy[0], 4 * n));
+		}
+
+		report("catmullrom-pts", n, timeKernel([&] { CatmullRomPts(&poly[0], &out[0], n, benchColor); }, &out[0], minTime));
+
+		bez.resize(4 * n);
+		CatmullRomPts(&poly[0], &bez[0], n, benchColor);
+		out.resize(CRSamples * n);
+		aos = timeKernel([&] { CatmullRomCurves(&bez[0], &out[0], n, benchColor); }, &out[0], minTime);
+		report("catmullrom-curve", n, aos);
+		ref = out;
+		double seconds = timeKernel([&] { CatmullRomCurvesBasis<CRSamples>(&bez[0], &out[0], n, benchColor); }, &out[0], minTime);
+		report("catmullrom-basis", n, seconds, aos, diffAoS(&ref[0], &out[0], CRSamples * n));
+	}
+
+	if (failed) {
+		fprintf(stderr, "ERROR: a kernel is more than %g off its reference\n", MaxDiff);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,293 @@
+#include <vector>
+#include <math.h>
+
+#include "curves.hpp"
+
+void Subdivision(Vertex* cur, const Vertex* pre, int n, float* color) {
+
+	float x0,x1;
+	float y0,y1;
+	int a,b;
+
+	for (int i = 0; i < n; i++) {
+		a = i - 1;
+		b = i + 1;
+		if (i == 0) {
+			a = n - 1;
+		}
+		if (i == n - 1) {
+			b = 0;
+		}
+
+		// calc P2i+1 xy, set xy and color
+		x0 = (pre[a].XYZW[0] + (6 * pre[i].XYZW[0]) + pre[b].XYZW[0]) / 8;
+		y0 = (pre[a].XYZW[1] + (6 * pre[i].XYZW[1]) + pre[b].XYZW[1]) / 8;
+		float newCoords0[] = { x0, y0, 0.0f, 1.0f };
+		cur[(i * 2) + 1].SetCoords(newCoords0);
+		cur[(i * 2) + 1].SetColor(color);
+		// calc P2i xy, set xy and color
+		x1 = ((4 * pre[a].XYZW[0]) + (4 * pre[i].XYZW[0])) / 8;
+		y1 = ((4 * pre[a].XYZW[1]) + (4 * pre[i].XYZW[1])) / 8;
+		float newCoords1[] = { x1, y1, 0.0f, 1.0f };
+		cur[i * 2].SetCoords(newCoords1);
+		cur[i * 2].SetColor(color);
+	}
+
+}
+
+// Level L point j sits on the B-spline knots (c - h, c, c + h), h = 2^-L and
+// c = (j + 1) h - 1 in units of the control polygon; that is the point
+// Subdivision() would reach after L steps. It is the blossom of the cubic piece
+// [k, k+1] containing c, found with three de Boor steps at those knots; when c
+// is a knot itself both neighbouring pieces give the same point.
+void SubdivisionDirect(const Vertex* p, int n, int level, bool limit, size_t begin, size_t end, CurveVertex* out) {
+	size_t total = (size_t)n << level;
+	size_t mask = ((size_t)1 << level) - 1;
+	float h = 1.0f / float((size_t)1 << level);
+	for (size_t j = begin; j < end; j++) {
+		size_t jj = (j % total) + 1;
+		int k = (int)((jj >> level) % n) - 1; // piece, may be -1
+		float c = float(jj & mask) * h; // knot in the piece, 0 <= c < 1
+		float u1 = limit ? c : c - h, u2 = c, u3 = limit ? c : c + h;
+		const Vertex* d[4];
+		for (int i = 0; i < 4; i++) {
+			d[i] = &p[(k - 1 + i + 2 * n) % n];
+		}
+		float x[3], y[3];
+		for (int i = 0; i < 3; i++) {
+			float a = (u1 + 2 - i) / 3;
+			x[i] = (1 - a) * d[i]->XYZW[0] + a * d[i + 1]->XYZW[0];
+			y[i] = (1 - a) * d[i]->XYZW[1] + a * d[i + 1]->XYZW[1];
+		}
+		for (int i = 0; i < 2; i++) {
+			float a = (u2 + 1 - i) / 2;
+			x[i] = (1 - a) * x[i] + a * x[i + 1];
+			y[i] = (1 - a) * y[i] + a * y[i + 1];
+		}
+		out[j - begin].XY[0] = (1 - u3) * x[0] + u3 * x[1];
+		out[j - begin].XY[1] = (1 - u3) * y[0] + u3 * y[1];
+	}
+}
+
+void BezierCurves(const Vertex* p, Vertex* c, int n, float* color) {
+
+	float x0,x1,x2,x3;
+	float y0,y1,y2,y3;
+	int a, b, e;
+
+	for (int i = 0; i < n; i++) {
+		a = i + 1;
+		b = i - 1;
+		e = i + 2;
+		if (i == n - 1) {
+			a = 0;
+		}
+		if (i == 0) {
+			b = n - 1;
+		}
+		if (i == n - 2) {
+			e = 0;
+		}
+		if (i == n - 1) {
+			e = 1 % n;
+		}
+
+		// calc c1 xy
+		x1 = ((2 * p[i].XYZW[0]) + p[a].XYZW[0]) / 3;
+		y1 = ((2 * p[i].XYZW[1]) + p[a].XYZW[1]) / 3;
+		float newCoords1[] = { x1, y1, 0.0f, 1.0f };
+		// calc c2 xy
+		x2 = (p[i].XYZW[0] + (2 * p[a].XYZW[0])) / 3;
+		y2 = (p[i].XYZW[1] + (2 * p[a].XYZW[1])) / 3;
+		float newCoords2[] = { x2, y2, 0.0f, 1.0f };
+
+		// Set xy and color for c1
+		c[4 * i + 1].SetCoords(newCoords1);
+		c[4 * i + 1].SetColor(color);
+		// Set xy and color for c2
+		c[4 * i + 2].SetCoords(newCoords2);
+		c[4 * i + 2].SetColor(color);
+
+		// calc c0 xy
+		x0 = (p[b].XYZW[0] + (2 * p[i].XYZW[0])) / 3;
+		y0 = (p[b].XYZW[1] + (2 * p[i].XYZW[1])) / 3;
+		// midpoint
+		x0 = (x0 + x1) / 2;
+		y0 = (y0 + y1) / 2;
+		float newCoords0[] = { x0, y0, 0.0f, 1.0f };
+		// calc c3 xy
+		x3 = ((2 * p[a].XYZW[0]) + p[e].XYZW[0]) / 3;
+		y3 = ((2 * p[a].XYZW[1]) + p[e].XYZW[1]) / 3;
+		// midpoint
+		x3 = (x3 + x2) / 2;
+		y3 = (y3 + y2) / 2;
+		float newCoords3[] = { x3, y3, 0.0f, 1.0f };
+
+		// Set xy and color for c0
+		c[4 * i].SetCoords(newCoords0);
+		c[4 * i].SetColor(color);
+		// Set xy and color for c3
+		c[4 * i + 3].SetCoords(newCoords3);
+		c[4 * i + 3].SetColor(color);
+	}
+}
+
+void CatmullRomPts(const Vertex* p, Vertex* c, int n, float* color) {
+	CatmullRomPtsRange(p, c, n, 0, n, color);
+}
+
+void CatmullRomPtsRange(const Vertex* p, Vertex* c, int n, int begin, int end, float* color) {
+
+	float x0, x1, x2, x3;
+	float y0, y1, y2, y3;
+	int a, b, e;
+
+	for (int i = begin; i < end; i++) {
+		if (i == n - 1) {
+			a = 0;
+		}
+		else {
+			a = i + 1;
+		}
+		if (a == n - 1) {
+			e = 0;
+		}
+		else {
+			e = a + 1;
+		}
+		if (i == 0) {
+			b = n - 1;
+		}
+		else {
+			b = i - 1;
+		}
+
+		float w = 0.2; // t value
+		float x1T = w * (p[a].XYZW[0] - p[b].XYZW[0]); // x1 tangent, ci0
+		float y1T = w * (p[a].XYZW[1] - p[b].XYZW[1]); // y1 tangent
+		float x2T = w * (p[e].XYZW[0] - p[i].XYZW[0]); // x2 tangent, ci3
+		float y2T = w * (p[e].XYZW[1] - p[i].XYZW[1]); // y2 tangent
+
+		// Calc c0,c1,c2,c3 xy
+		x0 = p[i].XYZW[0];
+		y0 = p[i].XYZW[1];
+		x3 = p[a].XYZW[0];
+		y3 = p[a].XYZW[1];
+		x1 = x0 + x1T;
+		y1 = y0 + y1T;
+		x2 = x3 - x2T;
+		y2 = y3 - y2T;
+
+		// Set xy and color for c0,c1,c2,c3
+		float newCoords0[] = { x0, y0, 0.0f, 1.0f };
+		c[4 * i].SetCoords(newCoords0);
+		c[4 * i].SetColor(color);
+		float newCoords1[] = { x1, y1, 0.0f, 1.0f };
+		c[4 * i + 1].SetCoords(newCoords1);
+		c[4 * i + 1].SetColor(color);
+		float newCoords2[] = { x2, y2, 0.0f, 1.0f };
+		c[4 * i + 2].SetCoords(newCoords2);
+		c[4 * i + 2].SetColor(color);
+		float newCoords3[] = { x3, y3, 0.0f, 1.0f };
+		c[4 * i + 3].SetCoords(newCoords3);
+		c[4 * i + 3].SetColor(color);
+	}
+}
+
+void CatmullRomCurves(const Vertex* pcr, Vertex* curve, int n, float* color) {
+
+	Vertex temp[4]; // temporary array to hold this segment's bezier points
+	float x, y, t;
+
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < CRSamples; j++) {
+			// copy this segment's bezier points from PCR into temp array
+			// (only the 4 points the de Casteljau steps below touch)
+			for (int k = 0; k < 4; k++) {
+				temp[k] = pcr[4 * i + k];
+			}
+			// calc curve using decasteljau
+			for (int a = 1; a < 4; a++) {
+				for (int b = 0; b < 4 - a; b++) {
+					// calc x,y
+					t = j / float(CRSamples);
+					x = (1.0f - t) * temp[b].XYZW[0] + t * temp[b + 1].XYZW[0];
+					y = (1.0f - t) * temp[b].XYZW[1] + t * temp[b + 1].XYZW[1];
+					// set xy for curve
+					float newCoords[] = { x, y, 0.0f, 1.0f };
+					temp[b].SetCoords(newCoords);
+				}
+			}
+			// copy data from temp array to PD VAO
+			curve[(CRSamples * i) + j].SetCoords(temp[0].XYZW);
+			curve[(CRSamples * i) + j].SetColor(color);
+		}
+	}
+}
+
+void CatmullRomCurvesBasis(const Vertex* pcr, Vertex* curve, int n, int samples, float* color) {
+
+	switch (samples) {
+	case 8: CatmullRomCurvesBasis<8>(pcr, curve, n, color); return;
+	case 15: CatmullRomCurvesBasis<15>(pcr, curve, n, color); return;
+	case 16: CatmullRomCurvesBasis<16>(pcr, curve, n, color); return;
+	case 32: CatmullRomCurvesBasis<32>(pcr, curve, n, color); return;
+	}
+
+	// uncommon count: same weights as BernsteinTable, built for this call
+	std::vector<float> w(4 * samples);
+	for (int j = 0; j < samples; j++) {
+		float t = j / float(samples);
+		float s = 1.0f - t;
+		w[4 * j] = s * s * s;
+		w[4 * j + 1] = 3 * s * s * t;
+		w[4 * j + 2] = 3 * s * t * t;
+		w[4 * j + 3] = t * t * t;
+	}
+	for (int i = 0; i < n; i++) {
+		const Vertex* c = pcr + 4 * i;
+		for (int j = 0; j < samples; j++) {
+			const float* wj = &w[4 * j];
+			float newCoords[] = {
+				wj[0] * c[0].XYZW[0] + wj[1] * c[1].XYZW[0] + wj[2] * c[2].XYZW[0] + wj[3] * c[3].XYZW[0],
+				wj[0] * c[0].XYZW[1] + wj[1] * c[1].XYZW[1] + wj[2] * c[2].XYZW[1] + wj[3] * c[3].XYZW[1],
+				0.0f, 1.0f };
+			curve[samples * i + j].SetCoords(newCoords);
+			curve[samples * i + j].SetColor(color);
+		}
+	}
+}
+
+// A straight line over a step h of the parameter is off the curve by at most
+// h^2 / 8 * max|B''|, and for a cubic |B''| <= 6 * the larger second difference
+// of the control points, so n samples are within 3/4 * that / n^2.
+int BezierSegmentSamples(const float* sx, const float* sy, float tolerance, int maxSamples) {
+	float ax = sx[0] - 2 * sx[1] + sx[2], ay = sy[0] - 2 * sy[1] + sy[2];
+	float bx = sx[1] - 2 * sx[2] + sx[3], by = sy[1] - 2 * sy[2] + sy[3];
+	float d = sqrtf(ax * ax + ay * ay);
+	float e = sqrtf(bx * bx + by * by);
+	float bend = d > e ? d : e;
+	float samples = ceilf(sqrtf(0.75f * bend / tolerance));
+	if (!(samples >= 1.0f)) {
+		return 1;
+	}
+	return samples < maxSamples ? (int)samples : maxSamples;
+}
+
+void CatmullRomCurvesAdaptive(const Vertex* pcr, CurveVertex* curve, const int* first, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		const Vertex* c = pcr + 4 * i;
+		int samples = first[i + 1] - first[i];
+		CurveVertex* out = curve + first[i];
+		for (int j = 0; j < samples; j++) {
+			BezierPoint(c, j / float(samples), out[j].XY);
+		}
+	}
+}
+
+void BezierPoint(const Vertex* c, float t, float* coords) {
+	float s = 1.0f - t;
+	float w0 = s * s * s, w1 = 3 * s * s * t, w2 = 3 * s * t * t, w3 = t * t * t;
+	coords[0] = w0 * c[0].XYZW[0] + w1 * c[1].XYZW[0] + w2 * c[2].XYZW[0] + w3 * c[3].XYZW[0];
+	coords[1] = w0 * c[0].XYZW[1] + w1 * c[1].XYZW[1] + w2 * c[2].XYZW[1] + w3 * c[3].XYZW[1];
+}
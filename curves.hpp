@@ -0,0 +1,147 @@
+#ifndef CURVES_HPP
+#define CURVES_HPP
+
+#include <stddef.h>
+
+// Curve kernels for the control polygon: subdivision, Bezier and Catmull-Rom.
+// No OpenGL in here, so these can be benchmarked and tested without a window.
+
+typedef struct Vertex {
+	float XYZW[4];
+	float RGBA[4];
+	void SetCoords(float *coords) {
+		XYZW[0] = coords[0];
+		XYZW[1] = coords[1];
+		XYZW[2] = coords[2];
+		XYZW[3] = coords[3];
+	}
+	void SetColor(float *color) {
+		RGBA[0] = color[0];
+		RGBA[1] = color[1];
+		RGBA[2] = color[2];
+		RGBA[3] = color[3];
+	}
+};
+
+// Compact vertex for generated curve points: x and y only, z = 0 and w = 1 are
+// implied and the colour is the whole object's. A quarter the size of Vertex.
+struct CurveVertex {
+	float XY[2];
+};
+
+// number of curve samples per Catmull-Rom segment
+const int CRSamples = 15;
+
+// Subdivision: one refinement step of a closed polygon, n points in pre -> 2n points in cur
+void Subdivision(Vertex* cur, const Vertex* pre, int n, float* color);
+// Direct subdivision: points begin..end-1 of subdivision level `level` of the closed
+// n-point polygon p (n << level points at that level; indices wrap around), written
+// to out. Each is taken straight from p through the cubic B-spline the stencil
+// refines, so no level in between is ever built and any depth works. limit
+// puts the points on the limit curve instead, at the same parameters.
+void SubdivisionDirect(const Vertex* p, int n, int level, bool limit, size_t begin, size_t end, CurveVertex* out);
+// Bezier Curves: n points in p -> 4n cubic Bezier control points in c
+void BezierCurves(const Vertex* p, Vertex* c, int n, float* color);
+// Catmull-Rom Curves: n points in p -> 4n Bezier control points in c,
+// then 4n control points in pcr -> n * CRSamples curve points in curve
+void CatmullRomPts(const Vertex* p, Vertex* c, int n, float* color);
+void CatmullRomCurves(const Vertex* pcr, Vertex* curve, int n, float* color);
+
+// Range versions for incremental updates: only points begin..end-1 of the n-point
+// polygon are recomputed (0 <= begin <= end <= n), neighbours still wrap around.
+// Output point i depends on input points:
+//   Subdivision          i-1 .. i+1
+//   Bezier, Catmull-Rom  i-1 .. i+2
+void CatmullRomPtsRange(const Vertex* p, Vertex* c, int n, int begin, int end, float* color);
+
+// Call f(first, last) for the plain index ranges that make up begin..end-1 taken
+// mod n; begin may be negative and end may pass n, as long as end - begin <= n.
+template <typename F>
+void ForEachCyclicRange(int n, int begin, int end, F f) {
+	int first = ((begin % n) + n) % n;
+	int len = end - begin;
+	if (first + len <= n) {
+		f(first, first + len);
+	}
+	else {
+		f(first, n);
+		f(0, first + len - n);
+	}
+}
+
+// Cubic Bernstein weights for each sample of a segment, t = j / Samples.
+// Built once per sample count; turns every curve sample into 4 multiply-adds per coordinate.
+template <int Samples>
+struct BernsteinTable {
+	float w[Samples][4];
+	BernsteinTable() {
+		for (int j = 0; j < Samples; j++) {
+			float t = j / float(Samples);
+			float s = 1.0f - t;
+			w[j][0] = s * s * s;
+			w[j][1] = 3 * s * s * t;
+			w[j][2] = 3 * s * t * t;
+			w[j][3] = t * t * t;
+		}
+	}
+};
+
+// Catmull-Rom Curves from a precomputed basis instead of de Casteljau.
+// Samples is a compile-time constant so the per-segment loop unrolls completely.
+template <int Samples>
+void CatmullRomCurvesBasis(const Vertex* pcr, Vertex* curve, int n, float* color) {
+	static const BernsteinTable<Samples> table;
+	for (int i = 0; i < n; i++) {
+		const Vertex* c = pcr + 4 * i;
+		float x0 = c[0].XYZW[0], x1 = c[1].XYZW[0], x2 = c[2].XYZW[0], x3 = c[3].XYZW[0];
+		float y0 = c[0].XYZW[1], y1 = c[1].XYZW[1], y2 = c[2].XYZW[1], y3 = c[3].XYZW[1];
+		Vertex* out = curve + Samples * i;
+		for (int j = 0; j < Samples; j++) {
+			const float* w = table.w[j];
+			float newCoords[] = {
+				w[0] * x0 + w[1] * x1 + w[2] * x2 + w[3] * x3,
+				w[0] * y0 + w[1] * y1 + w[2] * y2 + w[3] * y3,
+				0.0f, 1.0f };
+			out[j].SetCoords(newCoords);
+			out[j].SetColor(color);
+		}
+	}
+}
+
+// same, with the sample count chosen at runtime; the common counts go to
+// the unrolled templates, anything else uses a table built on the fly
+void CatmullRomCurvesBasis(const Vertex* pcr, Vertex* curve, int n, int samples, float* color);
+
+// Adaptive tessellation. The samples needed for one cubic Bezier segment so the
+// polyline through them stays within tolerance of the curve; sx, sy are its 4
+// control points in the space tolerance is measured in (pixels, say).
+int BezierSegmentSamples(const float* sx, const float* sy, float tolerance, int maxSamples);
+// most samples BezierSegmentSamples() is asked for per Catmull-Rom segment
+const int MaxCRSamples = 64;
+// Catmull-Rom Curves with a sample count per segment: segment i of pcr gets
+// first[i + 1] - first[i] samples, written from curve[first[i]]; only begin..end-1 are done
+void CatmullRomCurvesAdaptive(const Vertex* pcr, CurveVertex* curve, const int* first, int begin, int end);
+// point at t on the cubic Bezier segment with control points c[0..3]
+void BezierPoint(const Vertex* c, float t, float* coords);
+
+// SoA kernels, in curves_simd.cpp. x and y are separate arrays, z = 0 and w = 1 are implied.
+// Same output layout as the Vertex versions above.
+void SubdivisionSoA(float* cx, float* cy, const float* px, const float* py, int n);
+void BezierCurvesSoA(float* cx, float* cy, const float* px, const float* py, int n);
+void SubdivisionSoARange(float* cx, float* cy, const float* px, const float* py, int n, int begin, int end);
+void BezierCurvesSoARange(float* cx, float* cy, const float* px, const float* py, int n, int begin, int end);
+void VerticesToSoA(float* x, float* y, const Vertex* v, int n);
+void SoAToVertices(Vertex* v, const float* x, const float* y, int n, float* color);
+void SoAToCurveVertices(CurveVertex* v, const float* x, const float* y, int n);
+void VerticesToCurveVertices(CurveVertex* c, const Vertex* v, int n);
+
+// instruction set used by the SoA kernels, picked at runtime
+enum SimdLevel { SimdScalar, SimdSSE, SimdAVX2 };
+// best level this CPU supports
+SimdLevel SimdDetect(void);
+// use level, or the best supported one below it; returns the level in use
+SimdLevel SetSimdLevel(SimdLevel level);
+SimdLevel GetSimdLevel(void);
+const char* SimdLevelName(SimdLevel level);
+
+#endif
@@ -0,0 +1,280 @@
+// SoA versions of the subdivision and Bezier kernels with scalar, SSE and AVX2 paths.
+// x and y live in separate arrays; z = 0 and w = 1 are implied for every point.
+//
+// The vector paths only run over the interior of the polygon, where every
+// neighbour index is in range. The first and last points, which wrap around,
+// are peeled off and done by the scalar code, so there is no branch in the loop.
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "curves.hpp"
+
+// GCC and Clang need the instruction set enabled per function so the file
+// builds without -mavx2; MSVC allows the intrinsics anywhere.
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Subdivision, one point: P2i = (Pa + Pi) / 2, P2i+1 = (Pa + 6Pi + Pb) / 8
+static inline void subdivisionPoint(float* c, const float* p, int i, int a, int b) {
+	c[2 * i] = (4 * p[a] + 4 * p[i]) / 8;
+	c[2 * i + 1] = (p[a] + 6 * p[i] + p[b]) / 8;
+}
+
+// Bezier Curves, one point: c1, c2 at thirds of Pi..Pa, c0 and c3 at the midpoints
+// with the neighbouring segments' c2 and c1
+static inline void bezierPoint(float* c, const float* p, int i, int a, int b, int e) {
+	float c1 = (2 * p[i] + p[a]) / 3;
+	float c2 = (p[i] + 2 * p[a]) / 3;
+	c[4 * i] = ((p[b] + 2 * p[i]) / 3 + c1) / 2;
+	c[4 * i + 1] = c1;
+	c[4 * i + 2] = c2;
+	c[4 * i + 3] = ((2 * p[a] + p[e]) / 3 + c2) / 2;
+}
+
+// scalar code for points [begin, end), with wraparound at both ends of the polygon
+static void subdivisionRange(float* c, const float* p, int n, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		subdivisionPoint(c, p, i, i == 0 ? n - 1 : i - 1, i == n - 1 ? 0 : i + 1);
+	}
+}
+
+static void bezierRange(float* c, const float* p, int n, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		bezierPoint(c, p, i, (i + 1) % n, i == 0 ? n - 1 : i - 1, (i + 2) % n);
+	}
+}
+
+// Scalar
+static void subdivisionScalar(float* c, const float* p, int n) {
+	subdivisionRange(c, p, n, 0, n);
+}
+
+static void bezierScalar(float* c, const float* p, int n) {
+	bezierRange(c, p, n, 0, n);
+}
+
+// SSE, 4 points per iteration
+static void subdivisionSSE(float* c, const float* p, int n) {
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 six = _mm_set1_ps(6.0f);
+	const __m128 eighth = _mm_set1_ps(0.125f);
+	int i = 1;
+	for (; i + 4 <= n - 1; i += 4) {
+		__m128 pa = _mm_loadu_ps(p + i - 1);
+		__m128 pi = _mm_loadu_ps(p + i);
+		__m128 pb = _mm_loadu_ps(p + i + 1);
+		__m128 even = _mm_mul_ps(_mm_add_ps(pa, pi), half);
+		__m128 odd = _mm_mul_ps(_mm_add_ps(_mm_add_ps(pa, _mm_mul_ps(six, pi)), pb), eighth);
+		// interleave into P2i, P2i+1
+		_mm_storeu_ps(c + 2 * i, _mm_unpacklo_ps(even, odd));
+		_mm_storeu_ps(c + 2 * i + 4, _mm_unpackhi_ps(even, odd));
+	}
+	subdivisionRange(c, p, n, 0, 1);
+	subdivisionRange(c, p, n, i, n);
+}
+
+static void bezierSSE(float* c, const float* p, int n) {
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 third = _mm_set1_ps(1.0f / 3.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	int i = 1;
+	for (; i + 4 <= n - 2; i += 4) {
+		__m128 pb = _mm_loadu_ps(p + i - 1);
+		__m128 pi = _mm_loadu_ps(p + i);
+		__m128 pa = _mm_loadu_ps(p + i + 1);
+		__m128 pe = _mm_loadu_ps(p + i + 2);
+		__m128 c1 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(two, pi), pa), third);
+		__m128 c2 = _mm_mul_ps(_mm_add_ps(pi, _mm_mul_ps(two, pa)), third);
+		__m128 c0 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(pb, _mm_mul_ps(two, pi)), third), c1), half);
+		__m128 c3 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(two, pa), pe), third), c2), half);
+		// rows c0..c3 -> one column of 4 control points per input point
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(c + 4 * i, c0);
+		_mm_storeu_ps(c + 4 * i + 4, c1);
+		_mm_storeu_ps(c + 4 * i + 8, c2);
+		_mm_storeu_ps(c + 4 * i + 12, c3);
+	}
+	bezierRange(c, p, n, 0, 1);
+	bezierRange(c, p, n, i, n);
+}
+
+// AVX2, 8 points per iteration
+TARGET_AVX2 static void subdivisionAVX2(float* c, const float* p, int n) {
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 six = _mm256_set1_ps(6.0f);
+	const __m256 eighth = _mm256_set1_ps(0.125f);
+	int i = 1;
+	for (; i + 8 <= n - 1; i += 8) {
+		__m256 pa = _mm256_loadu_ps(p + i - 1);
+		__m256 pi = _mm256_loadu_ps(p + i);
+		__m256 pb = _mm256_loadu_ps(p + i + 1);
+		__m256 even = _mm256_mul_ps(_mm256_add_ps(pa, pi), half);
+		__m256 odd = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(pa, _mm256_mul_ps(six, pi)), pb), eighth);
+		// unpack works within 128-bit lanes, so put the lanes back in order afterwards
+		__m256 lo = _mm256_unpacklo_ps(even, odd);
+		__m256 hi = _mm256_unpackhi_ps(even, odd);
+		_mm256_storeu_ps(c + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(c + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	subdivisionRange(c, p, n, 0, 1);
+	subdivisionRange(c, p, n, i, n);
+}
+
+TARGET_AVX2 static void bezierAVX2(float* c, const float* p, int n) {
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 third = _mm256_set1_ps(1.0f / 3.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	int i = 1;
+	for (; i + 8 <= n - 2; i += 8) {
+		__m256 pb = _mm256_loadu_ps(p + i - 1);
+		__m256 pi = _mm256_loadu_ps(p + i);
+		__m256 pa = _mm256_loadu_ps(p + i + 1);
+		__m256 pe = _mm256_loadu_ps(p + i + 2);
+		__m256 c1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(two, pi), pa), third);
+		__m256 c2 = _mm256_mul_ps(_mm256_add_ps(pi, _mm256_mul_ps(two, pa)), third);
+		__m256 c0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(pb, _mm256_mul_ps(two, pi)), third), c1), half);
+		__m256 c3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(two, pa), pe), third), c2), half);
+		// 4x4 transpose in each 128-bit lane gives points {0,4}, {1,5}, {2,6}, {3,7}
+		__m256 t0 = _mm256_unpacklo_ps(c0, c1);
+		__m256 t1 = _mm256_unpacklo_ps(c2, c3);
+		__m256 t2 = _mm256_unpackhi_ps(c0, c1);
+		__m256 t3 = _mm256_unpackhi_ps(c2, c3);
+		__m256 q0 = _mm256_shuffle_ps(t0, t1, 0x44);
+		__m256 q1 = _mm256_shuffle_ps(t0, t1, 0xEE);
+		__m256 q2 = _mm256_shuffle_ps(t2, t3, 0x44);
+		__m256 q3 = _mm256_shuffle_ps(t2, t3, 0xEE);
+		_mm256_storeu_ps(c + 4 * i, _mm256_permute2f128_ps(q0, q1, 0x20));
+		_mm256_storeu_ps(c + 4 * i + 8, _mm256_permute2f128_ps(q2, q3, 0x20));
+		_mm256_storeu_ps(c + 4 * i + 16, _mm256_permute2f128_ps(q0, q1, 0x31));
+		_mm256_storeu_ps(c + 4 * i + 24, _mm256_permute2f128_ps(q2, q3, 0x31));
+	}
+	bezierRange(c, p, n, 0, 1);
+	bezierRange(c, p, n, i, n);
+}
+
+// Runtime dispatch
+typedef void (*SoAKernel)(float*, const float*, int);
+
+static SimdLevel simdLevel = SimdScalar;
+static SoAKernel subdivisionKernel = 0;
+static SoAKernel bezierKernel = 0;
+
+SimdLevel SimdDetect(void) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, 7, 0);
+	if ((info[1] & (1 << 5)) && (_xgetbv(0) & 6) == 6) {
+		return SimdAVX2;
+	}
+	return SimdSSE; // every x64 CPU has SSE2
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return SimdAVX2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return SimdSSE;
+	}
+	return SimdScalar;
+#endif
+}
+
+SimdLevel SetSimdLevel(SimdLevel level) {
+	SimdLevel best = SimdDetect();
+	if (level > best) {
+		level = best;
+	}
+	simdLevel = level;
+	switch (level) {
+	case SimdAVX2:
+		subdivisionKernel = subdivisionAVX2;
+		bezierKernel = bezierAVX2;
+		break;
+	case SimdSSE:
+		subdivisionKernel = subdivisionSSE;
+		bezierKernel = bezierSSE;
+		break;
+	default:
+		subdivisionKernel = subdivisionScalar;
+		bezierKernel = bezierScalar;
+		break;
+	}
+	return level;
+}
+
+SimdLevel GetSimdLevel(void) {
+	if (!subdivisionKernel) {
+		SetSimdLevel(SimdAVX2);
+	}
+	return simdLevel;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdAVX2: return "avx2";
+	case SimdSSE: return "sse";
+	default: return "scalar";
+	}
+}
+
+// the vector loops need at least one interior point on each side
+void SubdivisionSoA(float* cx, float* cy, const float* px, const float* py, int n) {
+	GetSimdLevel();
+	SoAKernel kernel = n > 3 ? subdivisionKernel : subdivisionScalar;
+	kernel(cx, px, n);
+	kernel(cy, py, n);
+}
+
+void BezierCurvesSoA(float* cx, float* cy, const float* px, const float* py, int n) {
+	GetSimdLevel();
+	SoAKernel kernel = n > 3 ? bezierKernel : bezierScalar;
+	kernel(cx, px, n);
+	kernel(cy, py, n);
+}
+
+// scalar is plenty for the handful of points an incremental update touches
+void SubdivisionSoARange(float* cx, float* cy, const float* px, const float* py, int n, int begin, int end) {
+	subdivisionRange(cx, px, n, begin, end);
+	subdivisionRange(cy, py, n, begin, end);
+}
+
+void BezierCurvesSoARange(float* cx, float* cy, const float* px, const float* py, int n, int begin, int end) {
+	bezierRange(cx, px, n, begin, end);
+	bezierRange(cy, py, n, begin, end);
+}
+
+void VerticesToSoA(float* x, float* y, const Vertex* v, int n) {
+	for (int i = 0; i < n; i++) {
+		x[i] = v[i].XYZW[0];
+		y[i] = v[i].XYZW[1];
+	}
+}
+
+void SoAToVertices(Vertex* v, const float* x, const float* y, int n, float* color) {
+	for (int i = 0; i < n; i++) {
+		float coords[] = { x[i], y[i], 0.0f, 1.0f };
+		v[i].SetCoords(coords);
+		v[i].SetColor(color);
+	}
+}
+
+void SoAToCurveVertices(CurveVertex* v, const float* x, const float* y, int n) {
+	for (int i = 0; i < n; i++) {
+		v[i].XY[0] = x[i];
+		v[i].XY[1] = y[i];
+	}
+}
+
+void VerticesToCurveVertices(CurveVertex* c, const Vertex* v, int n) {
+	for (int i = 0; i < n; i++) {
+		c[i].XY[0] = v[i].XYZW[0];
+		c[i].XY[1] = v[i].XYZW[1];
+	}
+}
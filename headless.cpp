@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "headless.hpp"
+
+// EGL is there on Linux and the BSDs; Windows and macOS builds, and any built
+// with HW1B_NO_EGL, get the stubs at the end
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(HW1B_NO_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLSurface surface = EGL_NO_SURFACE;
+static EGLContext context = EGL_NO_CONTEXT;
+
+// surfaceless display if the client extensions offer one, so no X server is needed
+static EGLDisplay openDisplay(void) {
+	const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay) {
+			EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (d != EGL_NO_DISPLAY) {
+				return d;
+			}
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool HeadlessInit(int width, int height) {
+	display = openDisplay();
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+		fprintf(stderr, "Failed to initialize EGL\n");
+		return false;
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+		fprintf(stderr, "Failed to find an EGL pbuffer config\n");
+		return false;
+	}
+
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+	surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+	if (surface == EGL_NO_SURFACE) {
+		fprintf(stderr, "Failed to create an EGL pbuffer\n");
+		return false;
+	}
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+		fprintf(stderr, "Failed to create an OpenGL 3.3 core context with EGL\n");
+		return false;
+	}
+	// never wait for a vertical blank
+	eglSwapInterval(display, 0);
+	return true;
+}
+
+void HeadlessSwapBuffers(void) {
+	eglSwapBuffers(display, surface);
+}
+
+void HeadlessTerminate(void) {
+	if (display == EGL_NO_DISPLAY) {
+		return;
+	}
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != EGL_NO_CONTEXT) {
+		eglDestroyContext(display, context);
+	}
+	if (surface != EGL_NO_SURFACE) {
+		eglDestroySurface(display, surface);
+	}
+	eglTerminate(display);
+	display = EGL_NO_DISPLAY;
+}
+
+#else
+
+bool HeadlessInit(int, int) {
+	fprintf(stderr, "ERROR: This build has no EGL, so no headless benchmark\n");
+	return false;
+}
+
+void HeadlessSwapBuffers(void) {
+}
+
+void HeadlessTerminate(void) {
+}
+
+#endif
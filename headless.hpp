@@ -0,0 +1,14 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+// Offscreen OpenGL 3.3 core context on an EGL pbuffer, for the benchmark mode.
+// Needs no window system or GPU: with Mesa it runs on llvmpipe. The surfaceless
+// platform is used when the EGL implementation has it, the default display otherwise.
+// Without EGL (Windows, macOS, or HW1B_NO_EGL) HeadlessInit() always fails.
+
+// create the context and make it current; false (with a message on stderr) on failure
+bool HeadlessInit(int width, int height);
+void HeadlessSwapBuffers(void);
+void HeadlessTerminate(void);
+
+#endif
@@ -4,6 +4,8 @@
 #include <vector>
 #include <array>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
 #include <math.h>
 // Include GLEW
 #include <GL/glew.h>
@@ -21,26 +23,19 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+// Include curve kernels
+#include "curves.hpp"
+#include "pool.hpp"
+#include "pickgrid.hpp"
+#include "headless.hpp"
+#include "profiler.hpp"
+#include "workers.hpp"
+#include "scene.hpp"
+#include "input.hpp"
+#include "shaders.hpp"
 
 #define PI 3.1415926535897
 
-typedef struct Vertex {
-	float XYZW[4];
-	float RGBA[4];
-	void SetCoords(float *coords) {
-		XYZW[0] = coords[0];
-		XYZW[1] = coords[1];
-		XYZW[2] = coords[2];
-		XYZW[3] = coords[3];
-	}
-	void SetColor(float *color) {
-		RGBA[0] = color[0];
-		RGBA[1] = color[1];
-		RGBA[2] = color[2];
-		RGBA[3] = color[3];
-	}
-};
-
 // ATTN: USE POINT STRUCTS FOR EASIER COMPUTATIONS
 typedef struct point {
 	float x, y, z;
@@ -58,45 +53,80 @@ typedef struct point {
 	point operator /(const float& a)const {
 		return point(x / a, y / a, z / a);
 	}
-	float* toArray() {
-		float array[] = { x, y, z, 1.0f };
-		return array;
-	}
 };
 
 // function prototypes
 int initWindow(void);
+int initHeadless(void);
+void initGUI(void);
 void initOpenGL(void);
-void createVAOs(Vertex[], unsigned short[], size_t, size_t, int);
+template <typename T> void createVAOs(GrowBuffer<T>&, int);
+void createVAOs(GrowBuffer<Vertex>&, GrowBuffer<GLuint>&, int);
+template <typename T> void uploadObject(int, GrowBuffer<T>&);
+void uploadObject(int, GrowBuffer<Vertex>&, GrowBuffer<GLuint>&);
+void markObjectDirty(int, size_t, size_t);
 void createObjects(void);
+void markDirty(int);
+glm::mat4 viewModelMatrix(int);
+int numViews(void);
+double benchNow(void);
+void createPickBuffer(void);
 void pickVertex(void);
+void pickedVertex(GLuint);
+void pollPick(void);
+void cursorPos(double*, double*);
+bool leftButtonDown(void);
+void replayInput(int);
 void moveVertex(void);
+void moveVertexTo(GLuint, float, float);
+void setGpuCurves(bool);
+void setCurves(const std::vector<SceneCurve>&, size_t);
+bool loadScene(const char*);
+void streamScene(void);
+bool saveScene(const char*, size_t*);
 void drawScene(void);
+void swapBuffers(void);
+void damage(void);
+void waitForDamage(void);
+void handleInput(void);
+void stampInput(void);
+void inputHandled(void);
+double frameSwapped(void);
 void cleanup(void);
+int runBenchmark(int, int, int, const char*, const char*, const char*, const char*, const char*);
 
 static void mouseCallback(GLFWwindow*, int, int, int);
 static void keyCallback(GLFWwindow*, int, int, int, int);
-
-// Subdivision
-void Subdivision(Vertex*, const Vertex*, int);
-// Bezier Curves
-void BezierCurves(const Vertex*, Vertex*);
-// Catmull-Rom Curves
-void CatmullRomPts(const Vertex*, Vertex*);
-void CatmullRomCurves(const Vertex*, Vertex*);
+static void refreshCallback(GLFWwindow*);
+static void cursorCallback(GLFWwindow*, double, double);
+static void resizeCallback(GLFWwindow*, int, int);
 
 // GLOBAL VARIABLES
 GLFWwindow* window;
+bool headless = false; // benchmark mode: EGL pbuffer instead of a GLFW window
+const int TraceFrames = 120; // frames kept for the trace dump (key T)
 const GLuint window_width = 1024, window_height = 768;
 
 glm::mat4 gProjectionMatrix;
 glm::mat4 gViewMatrix;
 
 GLuint gPickedIndex;
+const GLuint BackgroundIndex = 0xFFFFFFFF; // gPickedIndex when the click hit no point
 std::string gMessage;
 
-GLuint programID;
+// The shading program comes in variants that leave out what a primitive does
+// not need, see hw1bShade.vertexshader; drawScene() uses the cheapest for each draw
+enum ShadeVariant { ShadeFlat, ShadeLit, ShadePoints, NumShadeVariants };
+const char* ShadeDefines[NumShadeVariants] = { "#define FLAT\n", "#define LIT\n", "#define POINT_SPRITE\n" };
+struct ShadeProgram {
+	GLuint id;
+	GLint ViewMatrixID, LightID; // lit only
+	GLint ViewBaseID, ObjectColorID, VertexColorsID;
+};
+ShadeProgram shadePrograms[NumShadeVariants];
+int shadeInUse = -1; // variant in use, -1 if it may not be any
 GLuint pickingProgramID;
+GLuint curveProgramID;
 
 int pressed = 0;
 float pickedR;
@@ -104,28 +134,101 @@ float pickedG;
 float pickedB;
 bool isChanged = false;
 int count = 0;
-int curloopPos = 0;
 bool zPick = false;
 bool splitView = false;
+bool quadView = false;
 bool loop = false;
+bool gpuCurves = false; // evaluate the Bezier and Catmull-Rom objects in the vertex shader
+int curveSamples = CRSamples; // Catmull-Rom samples per segment when gpuCurves is on
+float loopSpeed = 1.0f; // world units per second the looping dot travels
+double loopDistance = 0.0; // along the Catmull-Rom curve, unwrapped
+double loopTime = -1.0; // clock when loopDistance was last advanced, < 0 while the dot is stopped
+float curveTolerance = 0.25f; // pixels the CPU Catmull-Rom curve may be off the true one, see tessellateCatmullRom()
+unsigned int curveVertices = 0; // in the CPU Catmull-Rom curve last drawn
+bool cpuPicking = false; // pick from pickGrid instead of rendering IDs and reading them back
+const char* scenePath = "hw1b_scene.bin"; // loaded with --scene, written with key S
+bool sceneStreaming = false; // Vertices is a mapped scene file whose points are still being read in
+bool replaying = false; // the input comes from a recording, see replayInput()
+// The input as the callbacks, or a replay, last left it; a frame handles all
+// that came in since the one before at once, so a fast drag costs one move a frame
+double cursor[2] = { window_width / 2, window_height / 2 }; // window pixels, (0,0) at the top left
+bool cursorMoved = false; // since the drag last followed it
+bool leftButton = false;
+GLint viewport[4]; // as set by glViewport(), kept here so reading it never waits for the GL
+
+// On demand, a frame is only drawn when something on screen changed, and the
+// main loop sleeps in glfwWaitEvents() in between. A change takes two frames to
+// reach the screen, as the curves are built a frame ahead, see createObjects().
+bool onDemand = true;
+const int PipelineFrames = 2;
+int damagedFrames = PipelineFrames; // frames still to draw for the last change
+const double WakeInterval = 1.0 / 60.0; // s between looks at work no event reports the end of
+
+// Input latency: from when the oldest event a frame handles came in, until the
+// frame that shows what it did has been swapped
+double inputStamp = -1.0; // oldest event not handled yet, < 0 if none
+double handledStamps[PipelineFrames] = { -1.0, -1.0 }; // by the last frames, newest first
+float inputLatency = 0.0f; // ms, last measured
 
 // ATTN: INCREASE THIS NUMBER AS YOU CREATE NEW OBJECTS
 const GLuint NumObjects = 10;	// number of different "objects" to be drawn
 GLuint VertexArrayId[NumObjects] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
 GLuint VertexBufferId[NumObjects] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
-GLuint IndexBufferId[NumObjects] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+GLuint IndexBufferId[NumObjects]; // 0 unless the object was created with indices
 size_t NumVert[NumObjects] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
 
-GLuint MatrixID;
-GLuint ViewMatrixID;
-GLuint ModelMatrixID;
+const int MaxViews = 4; // must match MAX_VIEWS in hw1bShade.vertexshader
+GLuint ViewsBufferId; // uniform buffer holding the Views block
 GLuint PickingMatrixID;
-GLuint pickingColorArrayID;
-GLuint pickingColorID;
-GLuint LightID;
+GLuint PickingBaseID;
+
+// GPU curves: the control point VBO is read as a buffer texture, and the
+// curve draws pull everything from it, so they need no vertex buffers at all
+GLuint ControlPointsTexture;
+GLuint CurveVertexArrayId;
+GLuint ControlPointsID;
+GLuint CurveRangesTexture; // and the curve each control point is on, see uploadCurveRanges()
+GLuint CurveRangesBufferId;
+GLuint CurveRangesID;
+GrowBuffer<GLint> curveRanges;
+int rangesVersion = -1; // object table in CurveRangesBufferId
+size_t rangesPoints = 0;
+GLuint SchemeID;
+GLuint SamplesID;
+GLuint CurveColorID;
+GLuint CurveViewBaseID;
+
+// Multi-draw: every curve of an object is one range of its buffer, and all of them
+// go in one call, see multiDraw(); with ARB_multi_draw_indirect the views are
+// instances of that call, otherwise there is a call per view and ViewBase says which
+bool multiDrawIndirect = false;
+GLuint IndirectBufferId;
+struct DrawArraysIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+std::vector<GLint> drawFirsts; // ranges of the multi-draw being put together
+std::vector<GLsizei> drawCounts;
+std::vector<DrawArraysIndirectCommand> drawCommands;
+size_t frameDrawCalls = 0;
+unsigned int drawCallsPerFrame = 0; // averaged over the last second, for the GUI
+
+// Direct subdivision: any level, evaluated straight from the control points in
+// chunks that are streamed through one small buffer, see drawDirect()
+bool directSubdivision = false;
+int directLevel = 8;
+bool directLimit = false; // the limit curve instead of the level's points
+const int DirectChunk = 65536; // points per chunk
+GLuint DirectVertexArrayId;
+GLuint DirectBufferId;
+GrowBuffer<CurveVertex> directChunk;
+int directLevelDrawn = 0; // deepest level drawDirect() drew last, for the GUI
 
 // Define objects
-Vertex Vertices[] =
+// starting control polygon, copied into Vertices at startup
+const Vertex initialVertices[] =
 {
 	{ { 1.0f, 0.5f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } }, // 0
 	{ { 0.5f, 1.5f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } }, // 1
@@ -139,54 +242,140 @@ Vertex Vertices[] =
 	{ { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } } // 9 
 };
 
-Vertex* PV = Vertices;
-
-unsigned short Indices[] = {
-	0, 1, 2, 3, 4, 5, 6, 7, 8, 9
-};
-
-const size_t IndexCount = sizeof(Indices) / sizeof(unsigned short);
-// ATTN: DON'T FORGET TO INCREASE THE ARRAY SIZE IN THE PICKING VERTEX SHADER WHEN YOU ADD MORE PICKING COLORS
-float pickingColor[IndexCount] = { 0 / 255.0f, 1 / 255.0f, 2 / 255.0f, 3 / 255.0f, 4 / 255.0f, 5 / 255.0f, 6 / 255.0f, 7 / 255.0f, 8 / 255.0f, 9 / 255.0f};
-unsigned short MC = IndexCount; // store a copy of originl indexcount
-std::vector<int> subIndexCount; // a int vector to store different indexcount for each subdivision level
-
 // ATTN: ADD YOU PER-OBJECT GLOBAL ARRAY DEFINITIONS HERE
-// indices array for each subdivision level
-unsigned short level1[20];
-unsigned short level2[40];
-unsigned short level3[80];
-unsigned short level4[160];
-unsigned short level5[320];
-// vertex array for each level of subdivision
-Vertex subdivision1[20];
-Vertex subdivision2[40];
-Vertex subdivision3[80];
-Vertex subdivision4[160];
-Vertex subdivision5[320];
-Vertex* PS1 = subdivision1;
-Vertex* PS2 = subdivision2;
-Vertex* PS3 = subdivision3;
-Vertex* PS4 = subdivision4;
-Vertex* PS5 = subdivision5;
-
-// bezier curves indices
-unsigned short bezierIndices[40];
-// bezier curves vertex array
-Vertex beziercurve[40];
-Vertex* PB = beziercurve;
-
-unsigned short catmullromIndices[40]; // indices for bezier points
-unsigned short decastelIndices[150]; // indices for CR curve
-// CR vertex array
-Vertex catmullrom[40];
-Vertex decastel[150]; // 15 points per segment
-Vertex* PCR = catmullrom;
-Vertex* PD = decastel;
-
-// looping dot's indice and vertex array
-unsigned short dotloopIndex[] = {0}; 
-Vertex dotloop[1];
+// every object is sized at runtime from the live control point count (Vertices.count)
+GrowBuffer<Vertex> Vertices;
+
+// The object table: the control points make up independent closed curves, each a
+// range of Vertices, in order. Every derived object holds all the curves back to
+// back, each at the same multiple of its first point (see objectRange()), so a
+// kind of object is one buffer, and all its curves are drawn in one multi-draw.
+std::vector<SceneCurve> curves; // empty for one curve of all the points
+int curvesVersion = 0; // bumped whenever curves is replaced
+const int MinCurvePoints = 3;
+
+const int MaxLevel = 5; // subdivision resets after this many levels
+
+// Everything derived from the control points, built on the worker threads.
+// There are two sets: the front one is uploaded and drawn while the back one is
+// built from the next frame's control points, see createObjects().
+struct CurveSet {
+	GrowBuffer<Vertex> points; // control points this set was built from
+	std::vector<SceneCurve> curves; // and the curves they make up, see clipCurves()
+	int curvesVersion;
+
+	// vertex array for each level of subdivision, [0] unused
+	GrowBuffer<CurveVertex> subdivision[MaxLevel + 1];
+
+	// bezier curves vertex array
+	GrowBuffer<CurveVertex> beziercurve;
+
+	// SoA x/y working copies for the SIMD subdivision and Bezier kernels; only the
+	// object being drawn is expanded back into Vertex form
+	GrowBuffer<float> ctrlX, ctrlY;
+	GrowBuffer<float> levelX[MaxLevel + 1], levelY[MaxLevel + 1];
+	GrowBuffer<float> bezierX, bezierY;
+
+	// CR vertex arrays
+	GrowBuffer<Vertex> catmullrom; // bezier points
+	GrowBuffer<CurveVertex> catmullromXY; // and as they are drawn
+	GrowBuffer<CurveVertex> decastel; // curve points, as many per segment as its size on screen needs
+	GrowBuffer<int> segmentFirst; // first curve point of each segment, and the total at [n]
+	GrowBuffer<double> arcLength; // length of the curve up to each of ArcSteps points per segment, n * ArcSteps + 1 entries
+
+	// looping dots' vertex array, one per curve
+	GrowBuffer<CurveVertex> dotloop;
+
+	// what the derived objects were last built from, so only what changed is redone
+	std::vector<int> dirtyPoints; // control points moved since this set was last built
+	size_t builtPoints; // control point count
+	int builtLevels; // subdivision levels up to date
+	int shownLevel; // subdivision level expanded into Vertex form
+	bool bezierBuilt;
+	bool catmullromBuilt; // catmullrom holds the segments' Bezier points
+	bool tessellated; // decastel is laid out for them
+	int layout; // which tessellateCatmullRom() laid decastel out
+	bool arcBuilt; // arcLength is measured along them
+
+	// settings the set was built for, so it is drawn the way it was built
+	int pressed;
+	int count;
+	bool loop;
+	bool gpuCurves;
+	bool direct; // draw directLevel instead of count, with drawDirect()
+	int directLevel;
+	std::vector<int> directLevels; // what drawDirect() draws of it, per curve, see directLevelOnScreen()
+	bool directLimit;
+	double loopDistance; // how far along the curve the looping dot is, before wrapping
+	// control points to window coordinates in each view, and the tolerance in pixels
+	glm::mat4 screen[MaxViews];
+	int views;
+	float tolerance;
+	// and what the Catmull-Rom curve was last tessellated for
+	glm::mat4 tessScreen[MaxViews];
+	int tessViews;
+	float tessTolerance;
+
+	// vertices of each object rewritten by this build, [dirtyBegin, dirtyEnd)
+	size_t dirtyBegin[NumObjects];
+	size_t dirtyEnd[NumObjects];
+
+	CurveSet() : curvesVersion(-1), builtPoints(0), builtLevels(0), shownLevel(0), bezierBuilt(false), catmullromBuilt(false),
+		tessellated(false), layout(0), arcBuilt(false), pressed(0), count(0), loop(false), gpuCurves(false),
+		direct(false), directLevel(0), directLimit(false), loopDistance(0.0), views(0), tolerance(0.0f),
+		tessViews(0), tessTolerance(0.0f) {
+		memset(dirtyBegin, 0, sizeof(dirtyBegin));
+		memset(dirtyEnd, 0, sizeof(dirtyEnd));
+	}
+};
+CurveSet curveSets[2];
+CurveSet* front = &curveSets[0];
+CurveSet* back = &curveSets[1];
+// Catmull-Rom layouts made so far, and the one in object 8's VBO. The sets each
+// keep their own layout, so a set can take the partial path against one the
+// other set has uploaded since; then the whole curve has to go up again.
+int layouts = 0;
+int uploadedLayout = 0;
+std::vector<int> dirtyPoints; // control points moved since the last createObjects()
+std::vector<int> lastDirty; // and the ones before that, which the back set has not seen either
+
+// control points projected into the window with view 0, for cpuPicking; kept up to date while dragging
+PickGrid pickGrid;
+bool pickGridBuilt = false;
+glm::mat4 pickGridMVP;
+const float PickRadius = 5.0f; // half the point size, so a hit is as generous as on the GPU
+
+// GPU picking: control point IDs are rendered into an offscreen buffer, again only
+// when the control points or the view changed, and read back through a pixel
+// buffer object with a fence, so a click never waits for the GPU
+GLuint PickFramebufferId;
+GLuint PickColorBufferId;
+GLuint PickDepthBufferId;
+GLuint PickPixelBufferId;
+bool idBufferDirty = true;
+glm::mat4 idBufferMVP;
+GLsync pickFence = 0; // read in flight
+const GLuint64 ReplayPickWait = 1000000000; // ns a replayed click waits for its read
+int pickRect[4]; // window rectangle being read, GL coordinates: x, y, width, height
+int pickCenter[2]; // cursor inside pickRect
+GLuint PickBase[NumObjects]; // first pick ID of each object in the ID buffer
+const int MaxPickNeighbourhood = 16;
+int pickNeighbourhood = 3; // read this many texels around the cursor as well, so near misses still pick
+double pickStartTime;
+float pickLatency = 0.0f; // ms from click to picked point, last pick
+unsigned int picksResolved = 0; // so the bench can tell a new pickLatency
+
+// size of each object's GL buffers, in elements, so they are only re-created when an object outgrows them
+size_t VBOCapacity[NumObjects];
+size_t IBOCapacity[NumObjects];
+// vertices of each object changed since its last upload, [DirtyBegin, DirtyEnd)
+size_t DirtyBegin[NumObjects];
+size_t DirtyEnd[NumObjects];
+// upload traffic this frame, and averaged over the last second for the GUI
+size_t frameUploadBytes = 0;
+size_t frameUploads = 0;
+unsigned int uploadBytesPerFrame = 0;
+unsigned int uploadsPerFrame = 0;
 
 float subdivideColor[] = { 0.0f, 1.0f, 1.0f, 1.0f }; // cyan
 float bezierColor[] = { 1.0f, 1.0f, 0.0f, 1.0f }; // yellow
@@ -196,552 +385,1212 @@ float zpickColor[] = { 0.0f, 0.0f, 1.0f, 1.0f }; // blue color for picked axis i
 float xypickColor[] = { 1.0f, 0.0f, 0.0f, 1.0f }; // red color for picked axis in XY plane movement
 float dotloopColor[] = { 1.0f, 1.0f, 0.0f, 1.0f }; // yellow color for looping vertex
 
-void createObjects(void)
+// Colour of each object. The derived objects are CurveVertex, xy only, and are
+// drawn in one colour; the control points (NULL) have a colour per vertex, for highlighting.
+float* ObjectColor[NumObjects] = { NULL, subdivideColor, subdivideColor, subdivideColor, subdivideColor, subdivideColor,
+	bezierColor, CRptColor, CRcurveColor, dotloopColor };
+
+// size every derived object of a set for n control points
+void sizeObjects(CurveSet& s, size_t n)
 {
-	// ATTN: DERIVE YOUR NEW OBJECTS HERE:
-	// each has one vertices {pos;color} and one indices array (no picking needed here)
-	if (pressed == 1) {
-		if (count % 6 != 0) {
-			Subdivision(PS1, PV, 1);
-			if (count > 1) {
-				Subdivision(PS2, PS1, 2);
-			}
-			if (count > 2) {
-				Subdivision(PS3, PS2, 3);
-			}
-			if (count > 3) {
-				Subdivision(PS4, PS3, 4);
-			}
-			if (count > 4) {
-				Subdivision(PS5, PS4, 5);
+	s.points.resize(n);
+	s.ctrlX.resize(n);
+	s.ctrlY.resize(n);
+	for (int level = 1; level <= MaxLevel; level++) {
+		s.subdivision[level].resize(n << level); // each subdivision doubles the count
+		s.levelX[level].resize(n << level);
+		s.levelY[level].resize(n << level);
+	}
+	s.beziercurve.resize(4 * n);
+	s.bezierX.resize(4 * n);
+	s.bezierY.resize(4 * n);
+	s.catmullrom.resize(4 * n);
+	s.catmullromXY.resize(4 * n);
+	// the Catmull-Rom curve itself is sized when it is tessellated, and the dots with the curves
+}
+
+// same as markObjectDirty(), but kept with the set until it is swapped to the front;
+// each task only marks its own objects, so the workers never share a range
+void markSetDirty(CurveSet& s, int ObjectId, size_t begin, size_t end)
+{
+	if (s.dirtyBegin[ObjectId] == s.dirtyEnd[ObjectId]) {
+		s.dirtyBegin[ObjectId] = begin;
+		s.dirtyEnd[ObjectId] = end;
+		return;
+	}
+	if (begin < s.dirtyBegin[ObjectId]) {
+		s.dirtyBegin[ObjectId] = begin;
+	}
+	if (end > s.dirtyEnd[ObjectId]) {
+		s.dirtyEnd[ObjectId] = end;
+	}
+}
+
+// curve of control point k in set s, -1 if it is on none
+int curveOf(const CurveSet& s, int k)
+{
+	// the last curve that starts at or before k
+	std::vector<SceneCurve>::const_iterator it = std::upper_bound(s.curves.begin(), s.curves.end(), k,
+		[](int k, const SceneCurve& curve) { return k < (int)curve.first; });
+	if (it == s.curves.begin() || k >= (int)(it[-1].first + it[-1].count)) {
+		return -1;
+	}
+	return int(it - s.curves.begin()) - 1;
+}
+
+// redo the subdivision points that depend on control point k, level by level;
+// the dependent neighbourhood doubles (plus a point each side) with every level
+void updateSubdivision(CurveSet& s, int k)
+{
+	int c = curveOf(s, k);
+	if (c < 0) {
+		return;
+	}
+	// everything below is within the curve, which starts at f << level on each level
+	int f = s.curves[c].first;
+	int n = s.curves[c].count;
+	int lo = k - f, hi = lo + 1; // changed points of the level above, may run past either end
+	const float* preX = s.ctrlX.data + f;
+	const float* preY = s.ctrlY.data + f;
+	for (int level = 1; level <= s.builtLevels; level++) {
+		int m = n << (level - 1);
+		size_t base = (size_t)f << level;
+		float* curX = s.levelX[level].data + base;
+		float* curY = s.levelY[level].data + base;
+		// points whose stencil reaches a changed point
+		lo -= 1;
+		hi += 1;
+		if (hi - lo >= m) {
+			lo = 0;
+			hi = m;
+		}
+		ForEachCyclicRange(m, lo, hi, [&](int first, int last) {
+			SubdivisionSoARange(curX, curY, preX, preY, m, first, last);
+			if (level == s.shownLevel) {
+				SoAToCurveVertices(s.subdivision[level].data + base + 2 * first, curX + 2 * first, curY + 2 * first, 2 * (last - first));
+				markSetDirty(s, level, base + 2 * first, base + 2 * last);
 			}
+		});
+		lo *= 2;
+		hi *= 2;
+		preX = curX;
+		preY = curY;
+	}
+}
+
+// redo the 4 Bezier segments that depend on control point k
+void updateBezier(CurveSet& s, int k)
+{
+	int c = curveOf(s, k);
+	if (c < 0) {
+		return;
+	}
+	int f = s.curves[c].first;
+	int n = s.curves[c].count;
+	int span = n < 4 ? n : 4;
+	ForEachCyclicRange(n, k - f - 2, k - f - 2 + span, [&](int first, int last) {
+		BezierCurvesSoARange(s.bezierX.data + 4 * f, s.bezierY.data + 4 * f, s.ctrlX.data + f, s.ctrlY.data + f, n, first, last);
+		first += f;
+		last += f;
+		SoAToCurveVertices(s.beziercurve.data + 4 * first, s.bezierX.data + 4 * first, s.bezierY.data + 4 * first, 4 * (last - first));
+		markSetDirty(s, 6, 4 * first, 4 * last);
+	});
+}
+
+// samples Catmull-Rom segment i needs to stay within tolerance in every view
+int segmentSamples(const CurveSet& s, int i)
+{
+	const Vertex* c = s.catmullrom.data + 4 * i;
+	int samples = 1;
+	for (int view = 0; view < s.views; view++) {
+		float sx[4], sy[4];
+		for (int k = 0; k < 4; k++) {
+			glm::vec4 p = s.screen[view] * glm::vec4(c[k].XYZW[0], c[k].XYZW[1], c[k].XYZW[2], c[k].XYZW[3]);
+			sx[k] = (p.x / p.w + 1.0f) * 0.5f * window_width;
+			sy[k] = (p.y / p.w + 1.0f) * 0.5f * window_height;
 		}
-		else {
-			// Reset
-			count = 0;
+		int needed = BezierSegmentSamples(sx, sy, s.tolerance, MaxCRSamples);
+		if (needed > samples) {
+			samples = needed;
 		}
 	}
-	if (pressed == 2) {
-		BezierCurves(PV, PB);
-	}
-	if (pressed == 3) {
-		CatmullRomPts(PV,PCR);
-		CatmullRomCurves(PCR,PD);
-	}
-	if (loop) {//update dot postion to run on catmull rom curve
-		if (curloopPos % 150 == 0) {
-			curloopPos = 0;
+	return samples;
+}
+
+// Level s.directLevel of curve c, or the first level with no edge over a pixel
+// in any view if that comes sooner; the levels past it draw the same pixels.
+// A subdivision step at least halves the longest edge of the polygon.
+int directLevelOnScreen(const CurveSet& s, int c)
+{
+	int f = s.curves[c].first;
+	int n = s.curves[c].count;
+	float longest = 0.0f;
+	for (int view = 0; view < s.views; view++) {
+		float lastX = 0.0f, lastY = 0.0f;
+		for (int i = 0; i <= n; i++) {
+			const Vertex& v = s.points[f + i % n];
+			glm::vec4 p = s.screen[view] * glm::vec4(v.XYZW[0], v.XYZW[1], v.XYZW[2], v.XYZW[3]);
+			float x = (p.x / p.w + 1.0f) * 0.5f * window_width;
+			float y = (p.y / p.w + 1.0f) * 0.5f * window_height;
+			if (i > 0) {
+				longest = std::max(longest, hypotf(x - lastX, y - lastY));
+			}
+			lastX = x;
+			lastY = y;
 		}
-		CatmullRomPts(PV, PCR);
-		CatmullRomCurves(PCR, PD);
-		dotloop[0].SetCoords(decastel[curloopPos].XYZW);
-		dotloop[0].SetColor(dotloopColor);
-		curloopPos++;
 	}
+	int level = 1;
+	for (longest *= 0.5f; level < s.directLevel && longest > 1.0f; level++) {
+		longest *= 0.5f;
+	}
+	return level;
 }
 
-void Subdivision(Vertex* cur, const Vertex* pre, int level) {
+// control points up to the end of the last curve; the curves cover all of them
+int curvesEnd(const CurveSet& s)
+{
+	return s.curves.empty() ? 0 : s.curves.back().first + s.curves.back().count;
+}
+
+// Lay the whole Catmull-Rom curve out again and evaluate it. Flat or small
+// segments get few points and tight bends many, all to the same pixel tolerance.
+void tessellateCatmullRom(CurveSet& s)
+{
+	int n = s.points.count;
+	int end = curvesEnd(s);
+	s.segmentFirst.resize(n + 1);
+	s.segmentFirst[0] = 0;
+	for (int i = 0; i < n; i++) {
+		s.segmentFirst[i + 1] = s.segmentFirst[i] + (i < end ? segmentSamples(s, i) : 0);
+	}
+	s.decastel.resize(s.segmentFirst[n]);
+	CatmullRomCurvesAdaptive(s.catmullrom.data, s.decastel.data, s.segmentFirst.data, 0, end);
+	// only one set is built at a time, so this is never raced
+	s.layout = ++layouts;
+	markSetDirty(s, 8, 0, s.segmentFirst[n]);
+	for (int view = 0; view < s.views; view++) {
+		s.tessScreen[view] = s.screen[view];
+	}
+	s.tessViews = s.views;
+	s.tessTolerance = s.tolerance;
+	s.tessellated = true;
+}
 
-	float x0,x1;
-	float y0,y1;
-	int a,b;
-	int Vnum = subIndexCount.at(level - 1);
+// the screen or the tolerance has changed since the curve was tessellated
+bool tessellationStale(const CurveSet& s)
+{
+	if (s.views != s.tessViews || s.tolerance != s.tessTolerance) {
+		return true;
+	}
+	for (int view = 0; view < s.views; view++) {
+		if (s.screen[view] != s.tessScreen[view]) {
+			return true;
+		}
+	}
+	return false;
+}
 
-	for (int i = 0; i < Vnum; i++) {
-		a = i - 1;
-		b = i + 1;
-		if (i == 0) {
-			a = Vnum - 1;
+// redo the 4 Catmull-Rom segments that depend on control point k; if one of
+// them now needs a different number of samples the curve is left to be laid out again
+void updateCatmullRom(CurveSet& s, int k)
+{
+	int c = curveOf(s, k);
+	if (c < 0) {
+		return;
+	}
+	int f = s.curves[c].first;
+	int n = s.curves[c].count;
+	int span = n < 4 ? n : 4;
+	ForEachCyclicRange(n, k - f - 2, k - f - 2 + span, [&](int first, int last) {
+		CatmullRomPtsRange(s.points.data + f, s.catmullrom.data + 4 * f, n, first, last, CRptColor);
+		first += f;
+		last += f;
+		VerticesToCurveVertices(s.catmullromXY.data + 4 * first, s.catmullrom.data + 4 * first, 4 * (last - first));
+		markSetDirty(s, 7, 4 * first, 4 * last);
+		for (int i = first; i < last && s.tessellated; i++) {
+			if (segmentSamples(s, i) != s.segmentFirst[i + 1] - s.segmentFirst[i]) {
+				s.tessellated = false;
+			}
 		}
-		if (i == Vnum - 1) {
-			b = 0;
+		if (s.tessellated) {
+			CatmullRomCurvesAdaptive(s.catmullrom.data, s.decastel.data, s.segmentFirst.data, first, last);
+			markSetDirty(s, 8, s.segmentFirst[first], s.segmentFirst[last]);
 		}
+	});
+}
 
-		// calc P2i+1 xy, set xy and color
-		x0 = (pre[a].XYZW[0] + (6 * pre[i].XYZW[0]) + pre[b].XYZW[0]) / 8;
-		y0 = (pre[a].XYZW[1] + (6 * pre[i].XYZW[1]) + pre[b].XYZW[1]) / 8;
-		float newCoords0[] = { x0, y0, 0.0f, 1.0f };
-		cur[(i * 2) + 1].SetCoords(newCoords0);
-		cur[(i * 2) + 1].SetColor(subdivideColor);
-		// calc P2i xy, set xy and color
-		x1 = ((4 * pre[a].XYZW[0]) + (4 * pre[i].XYZW[0])) / 8;
-		y1 = ((4 * pre[a].XYZW[1]) + (4 * pre[i].XYZW[1])) / 8;
-		float newCoords1[] = { x1, y1, 0.0f, 1.0f };
-		cur[i * 2].SetCoords(newCoords1);
-		cur[i * 2].SetColor(subdivideColor);
+// Cumulative length of the Catmull-Rom curves, measured over ArcSteps chords per
+// segment and running on from one curve to the next, so curve c's share is
+// [first * ArcSteps, (first + count) * ArcSteps]. Only redone when the control
+// points move; placing a dot is then a binary search. The sum is a double: in a
+// float, chords on a scene of a million points drop below one ulp of it.
+const int ArcSteps = 16;
+void measureCatmullRom(CurveSet& s)
+{
+	int n = s.points.count;
+	s.arcLength.resize(n * ArcSteps + 1);
+	s.arcLength[0] = 0.0;
+	double length = 0.0;
+	for (size_t c = 0; c < s.curves.size(); c++) {
+		int first = s.curves[c].first;
+		int last = first + s.curves[c].count;
+		float prev[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		BezierPoint(s.catmullrom.data + 4 * first, 0.0f, prev);
+		for (int i = first; i < last; i++) {
+			const Vertex* p4 = s.catmullrom.data + 4 * i;
+			for (int j = 1; j <= ArcSteps; j++) {
+				float p[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				BezierPoint(p4, j / float(ArcSteps), p);
+				length += sqrtf((p[0] - prev[0]) * (p[0] - prev[0]) + (p[1] - prev[1]) * (p[1] - prev[1]));
+				s.arcLength[i * ArcSteps + j] = length;
+				prev[0] = p[0];
+				prev[1] = p[1];
+			}
+		}
 	}
+	s.arcBuilt = true;
+}
 
+// point distance along Catmull-Rom curve c, wrapping around its length
+void pointAtDistance(const CurveSet& s, int c, double distance, float* coords)
+{
+	int begin = s.curves[c].first * ArcSteps;
+	int last = (s.curves[c].first + s.curves[c].count) * ArcSteps;
+	const double* arc = s.arcLength.data;
+	double length = arc[last] - arc[begin];
+	double d = arc[begin] + (length > 0.0 ? fmod(distance, length) : 0.0);
+	// first table entry past d, then linear in the curve parameter between it and the one before
+	int k = std::upper_bound(arc + begin + 1, arc + last + 1, d) - arc;
+	if (k > last) {
+		k = last;
+	}
+	float f = arc[k] > arc[k - 1] ? float((d - arc[k - 1]) / (arc[k] - arc[k - 1])) : 0.0f;
+	int segment = (k - 1) / ArcSteps;
+	float t = ((k - 1) % ArcSteps + f) / ArcSteps;
+	BezierPoint(s.catmullrom.data + 4 * segment, t, coords);
 }
 
-void BezierCurves(const Vertex* p, Vertex* c) {
+// control point k has moved
+void markDirty(int k)
+{
+	if (dirtyPoints.empty() || dirtyPoints.back() != k) {
+		dirtyPoints.push_back(k);
+	}
+}
 
-	float x0,x1,x2,x3; 
-	float y0,y1,y2,y3;
-	int a, b, e;
+// forget everything a set derived from the control points
+void invalidateObjects(CurveSet& s)
+{
+	s.builtLevels = 0;
+	s.shownLevel = 0;
+	s.bezierBuilt = false;
+	s.catmullromBuilt = false;
+	s.tessellated = false;
+	s.arcBuilt = false;
+	s.dirtyPoints.clear();
+	pickGridBuilt = false;
+}
 
-	for (int i = 0; i < IndexCount; i++) {
-		a = i + 1;
-		b = i - 1;
-		e = i + 2;
-		if (i == IndexCount - 1) {
-			a = 0;
+// subdivision task: patch the built levels, then build up to the one shown
+void buildSubdivision(CurveSet& s)
+{
+	int n = s.points.count;
+	for (size_t d = 0; d < s.dirtyPoints.size(); d++) {
+		updateSubdivision(s, s.dirtyPoints[d]);
+	}
+	if (s.pressed == 1 && s.direct) {
+		// measured here, off the render thread, which then only evaluates what shows
+		s.directLevels.resize(s.curves.size());
+		for (size_t c = 0; c < s.curves.size(); c++) {
+			s.directLevels[c] = directLevelOnScreen(s, c);
 		}
-		if (i == 0) {
-			b = IndexCount - 1;
+	}
+	if (s.pressed != 1 || s.count == 0 || s.direct) {
+		return;
+	}
+	for (int level = s.builtLevels + 1; level <= s.count; level++) {
+		const float* preX = level == 1 ? s.ctrlX.data : s.levelX[level - 1].data;
+		const float* preY = level == 1 ? s.ctrlY.data : s.levelY[level - 1].data;
+		for (size_t c = 0; c < s.curves.size(); c++) {
+			size_t f = s.curves[c].first;
+			SubdivisionSoA(s.levelX[level].data + (f << level), s.levelY[level].data + (f << level),
+				preX + (f << (level - 1)), preY + (f << (level - 1)), s.curves[c].count << (level - 1));
+		}
+		s.builtLevels = level;
+	}
+	if (s.shownLevel != s.count) {
+		SoAToCurveVertices(s.subdivision[s.count].data, s.levelX[s.count].data, s.levelY[s.count].data, n << s.count);
+		markSetDirty(s, s.count, 0, n << s.count);
+		s.shownLevel = s.count;
+	}
+}
+
+// Bezier task
+void buildBezier(CurveSet& s)
+{
+	int n = s.points.count;
+	if (s.bezierBuilt) {
+		for (size_t d = 0; d < s.dirtyPoints.size(); d++) {
+			updateBezier(s, s.dirtyPoints[d]);
 		}
-		if (i == IndexCount - 2) {
-			e = 0;
+	}
+	else if (s.pressed == 2 && !s.gpuCurves) {
+		for (size_t c = 0; c < s.curves.size(); c++) {
+			size_t f = s.curves[c].first;
+			BezierCurvesSoA(s.bezierX.data + 4 * f, s.bezierY.data + 4 * f, s.ctrlX.data + f, s.ctrlY.data + f, s.curves[c].count);
 		}
+		SoAToCurveVertices(s.beziercurve.data, s.bezierX.data, s.bezierY.data, 4 * n);
+		markSetDirty(s, 6, 0, 4 * n);
+		s.bezierBuilt = true;
+	}
+}
 
-		// calc c1 xy
-		x1 = ((2 * p[i].XYZW[0]) + p[a].XYZW[0]) / 3;
-		y1 = ((2 * p[i].XYZW[1]) + p[a].XYZW[1]) / 3;
-		float newCoords1[] = { x1, y1, 0.0f, 1.0f };
-		// calc c2 xy
-		x2 = (p[i].XYZW[0] + (2 * p[a].XYZW[0])) / 3;
-		y2 = (p[i].XYZW[1] + (2 * p[a].XYZW[1])) / 3;
-		float newCoords2[] = { x2, y2, 0.0f, 1.0f };
+// Catmull-Rom task, with the looping dots that run on it
+void buildCatmullRom(CurveSet& s)
+{
+	int n = s.points.count;
+	bool shown = s.pressed == 3 && !s.gpuCurves;
+	if (s.catmullromBuilt) {
+		for (size_t d = 0; d < s.dirtyPoints.size(); d++) {
+			updateCatmullRom(s, s.dirtyPoints[d]);
+		}
+		if (!s.dirtyPoints.empty()) {
+			s.arcBuilt = false;
+		}
+	}
+	else if (shown || s.loop) {
+		for (size_t c = 0; c < s.curves.size(); c++) {
+			size_t f = s.curves[c].first;
+			CatmullRomPts(s.points.data + f, s.catmullrom.data + 4 * f, s.curves[c].count, CRptColor);
+		}
+		VerticesToCurveVertices(s.catmullromXY.data, s.catmullrom.data, 4 * n);
+		markSetDirty(s, 7, 0, 4 * n);
+		s.catmullromBuilt = true;
+		s.tessellated = false;
+		s.arcBuilt = false;
+	}
+	if (shown && (!s.tessellated || tessellationStale(s))) {
+		tessellateCatmullRom(s);
+	}
+	if (s.loop) {
+		if (!s.arcBuilt) {
+			measureCatmullRom(s);
+		}
+		for (size_t c = 0; c < s.curves.size(); c++) {
+			pointAtDistance(s, c, s.loopDistance, s.dotloop[c].XY);
+		}
+		markSetDirty(s, 9, 0, s.curves.size());
+	}
+}
 
-		// Set xy and color for c1
-		c[4 * i + 1].SetCoords(newCoords1);
-		c[4 * i + 1].SetColor(bezierColor);
-		// Set xy and color for c2
-		c[4 * i + 2].SetCoords(newCoords2);
-		c[4 * i + 2].SetColor(bezierColor);
+// The object table as far as the first n control points go, into out. A curve
+// they end inside is cut short there, and left out if that leaves too little of it.
+void clipCurves(std::vector<SceneCurve>& out, size_t n)
+{
+	out.clear();
+	if (curves.empty()) {
+		if (n >= MinCurvePoints) {
+			SceneCurve all = { 0, (uint32_t)n };
+			out.push_back(all);
+		}
+		return;
+	}
+	for (size_t c = 0; c < curves.size() && curves[c].first + MinCurvePoints <= n; c++) {
+		SceneCurve curve = curves[c];
+		if (curve.first + curve.count > n) {
+			curve.count = n - curve.first;
+		}
+		out.push_back(curve);
+	}
+}
 
-		// calc c0 xy
-		x0 = (p[b].XYZW[0] + (2 * p[i].XYZW[0])) / 3;
-		y0 = (p[b].XYZW[1] + (2 * p[i].XYZW[1])) / 3;
-		// midpoint
-		x0 = (x0 + x1) / 2;
-		y0 = (y0 + y1) / 2;
-		float newCoords0[] = { x0, y0, 0.0f, 1.0f };
-		// calc c3 xy
-		x3 = ((2 * p[a].XYZW[0]) + p[e].XYZW[0]) / 3;
-		y3 = ((2 * p[a].XYZW[1]) + p[e].XYZW[1]) / 3;
-		// midpoint
-		x3 = (x3 + x2) / 2;
-		y3 = (y3 + y2) / 2;
-		float newCoords3[] = { x3, y3, 0.0f, 1.0f };
+// Take a snapshot of the control points and settings into set s and hand its
+// curves to the workers. Runs on the render thread; the workers only ever see s.
+void startCurveBuild(CurveSet& s)
+{
+	if (pressed == 1 && count % (MaxLevel + 1) == 0) {
+		// Reset
+		count = 0;
+	}
+	s.pressed = pressed;
+	s.count = count;
+	s.loop = loop;
+	s.gpuCurves = gpuCurves;
+	s.direct = directSubdivision;
+	s.directLevel = directLevel;
+	s.directLimit = directLimit;
+	s.views = numViews();
+	for (int view = 0; view < s.views; view++) {
+		s.screen[view] = gProjectionMatrix * gViewMatrix * viewModelMatrix(view);
+	}
+	s.tolerance = curveTolerance;
+	memset(s.dirtyBegin, 0, sizeof(s.dirtyBegin));
+	memset(s.dirtyEnd, 0, sizeof(s.dirtyEnd));
+
+	int n = Vertices.count;
+	sizeObjects(s, n);
+	// the set was last built two frames ago, so it has to catch up on both frames' moves
+	s.dirtyPoints.clear();
+	s.dirtyPoints.insert(s.dirtyPoints.end(), lastDirty.begin(), lastDirty.end());
+	s.dirtyPoints.insert(s.dirtyPoints.end(), dirtyPoints.begin(), dirtyPoints.end());
+	lastDirty.swap(dirtyPoints);
+	dirtyPoints.clear();
+	// a new polygon, or so many edits that starting over is cheaper
+	if (n != (int)s.builtPoints || s.curvesVersion != curvesVersion || s.dirtyPoints.size() * 8 > (size_t)n) {
+		clipCurves(s.curves, n);
+		s.curvesVersion = curvesVersion;
+		s.dotloop.resize(s.curves.size());
+		if (n > (int)s.builtPoints) {
+			// points are only ever appended, by streamScene(), so only those go up
+			markObjectDirty(0, s.builtPoints, n);
+		}
+		else if (n != (int)s.builtPoints) {
+			markObjectDirty(0, 0, n);
+		}
+		invalidateObjects(s);
+		memcpy(s.points.data, Vertices.data, n * sizeof(Vertex));
+		VerticesToSoA(s.ctrlX.data, s.ctrlY.data, s.points.data, n);
+		s.builtPoints = n;
+	}
+	for (size_t d = 0; d < s.dirtyPoints.size(); d++) {
+		int k = s.dirtyPoints[d];
+		s.points[k] = Vertices[k];
+		s.ctrlX[k] = Vertices[k].XYZW[0];
+		s.ctrlY[k] = Vertices[k].XYZW[1];
+	}
+	if (s.gpuCurves) {
+		// the CPU copies stop being patched while the GPU draws the curves;
+		// the looping dot still runs on the CPU's Catmull-Rom points
+		s.bezierBuilt = false;
+		s.tessellated = false;
+		if (!loop) {
+			s.catmullromBuilt = false;
+		}
+	}
 
-		// Set xy and color for c0
-		c[4 * i].SetCoords(newCoords0);
-		c[4 * i].SetColor(bezierColor);
-		// Set xy and color for c3
-		c[4 * i + 3].SetCoords(newCoords3);
-		c[4 * i + 3].SetColor(bezierColor);
+	// the looping dot moves with the clock, not the frame rate
+	if (loop) {
+		double now = benchNow();
+		if (loopTime >= 0.0) {
+			loopDistance += loopSpeed * (now - loopTime);
+		}
+		loopTime = now;
+		s.loopDistance = loopDistance;
+	}
+	else {
+		loopTime = -1.0;
 	}
-}
 
-void CatmullRomPts(const Vertex* p, Vertex* c) {
+	// the three kinds of curve share only the control points, which are read-only now
+	CurveSet* set = &s;
+	WorkersSubmit([set]() { buildSubdivision(*set); });
+	WorkersSubmit([set]() { buildBezier(*set); });
+	WorkersSubmit([set]() { buildCatmullRom(*set); });
+}
 
-	float x0, x1, x2, x3;
-	float y0, y1, y2, y3;
-	int a, b, e;
+// Curves are pipelined one frame deep: this frame draws the set built while the
+// last frame was drawn and swapped, and the next set is built in the meantime.
+void createObjects(void)
+{
+	// ATTN: DERIVE YOUR NEW OBJECTS HERE:
+	// each has one vertices {pos;color} array, and indices only if its primitives share vertices (no picking needed here)
+	WorkersWait();
+	CurveSet* built = back;
+	back = front;
+	front = built;
+	for (GLuint ObjectId = 1; ObjectId < NumObjects; ObjectId++) {
+		if (front->dirtyBegin[ObjectId] != front->dirtyEnd[ObjectId]) {
+			markObjectDirty(ObjectId, front->dirtyBegin[ObjectId], front->dirtyEnd[ObjectId]);
+		}
+	}
+	if (front->layout != uploadedLayout) {
+		markObjectDirty(8, 0, front->decastel.count);
+		uploadedLayout = front->layout;
+	}
+	startCurveBuild(*back);
+}
 
-	for (int i = 0; i < IndexCount; i++) {
-		if (i == IndexCount - 1) {
-			a = 0;
+// Model matrix of one on-screen view of the scene. View 0 is the one used for picking and dragging.
+// split view: front (top half) and side (bottom half); quad view: front, side, top and a 3/4 view
+glm::mat4 viewModelMatrix(int view)
+{
+	glm::mat4 ModelMatrix = glm::mat4(1.0); // TranslationMatrix * RotationMatrix;
+	if (quadView) {
+		// Scale down to a quarter of the screen and translate into its quadrant
+		ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.6f));
+		ModelMatrix = glm::translate(ModelMatrix, glm::vec3(view % 2 == 0 ? 3.3f : -3.3f, view < 2 ? 2.5f : -2.5f, 0.0f));
+		if (view == 1) {
+			// Rotate Around Y Axis by PI/2 for side view
+			ModelMatrix = glm::rotate(ModelMatrix, float(PI / 2), glm::vec3(0.0f, 1.0f, 0.0f));
 		}
-		else {
-			a = i + 1;
+		if (view == 2) {
+			// Rotate Around X Axis by PI/2 for top view
+			ModelMatrix = glm::rotate(ModelMatrix, float(PI / 2), glm::vec3(1.0f, 0.0f, 0.0f));
+		}
+		if (view == 3) {
+			// Tilt towards the camera for a 3/4 view
+			ModelMatrix = glm::rotate(ModelMatrix, float(PI / 6), glm::vec3(1.0f, 0.0f, 0.0f));
+			ModelMatrix = glm::rotate(ModelMatrix, float(PI / 4), glm::vec3(0.0f, 1.0f, 0.0f));
 		}
-		if (a == IndexCount - 1) {
-			e = 0;
+	}
+	else if (splitView) {
+		// Scale ModelMatrix
+		ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.8f));
+		if (view == 0) {
+			// Translate ModelMatrix Upwards from Origin
+			ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, 2.0f, 0.0f));
 		}
 		else {
-			e = a + 1;
+			// Translate ModelMatrix Downwards from Origin
+			ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, -2.0f, 0.0f));
+			// Rotate ModelMatrix Around Y Axis by PI/2 for side view
+			ModelMatrix = glm::rotate(ModelMatrix, float(PI / 2), glm::vec3(0.0f, 1.0f, 0.0f));
 		}
-		if (i == 0) {
-			b = IndexCount - 1;
+	}
+	return ModelMatrix;
+}
+
+int numViews(void)
+{
+	return quadView ? 4 : (splitView ? 2 : 1);
+}
+
+// Vertex attributes of each layout, for the bound VAO and array buffer. A full
+// Vertex carries its own colour; a CurveVertex is xy only, GL fills in z = 0 and
+// w = 1, and the colour comes from ObjectColor.
+void vertexFormat(const Vertex*)
+{
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, RGBA));
+	glEnableVertexAttribArray(0);	// position
+	glEnableVertexAttribArray(1);	// color
+}
+
+void vertexFormat(const CurveVertex*)
+{
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(CurveVertex), 0);
+	glEnableVertexAttribArray(0);	// position
+}
+
+// Draw every range in drawFirsts/drawCounts once per view, in as few calls as the
+// GL allows: one indirect multi-draw with a view per instance, or failing that one
+// glMultiDrawArrays per view, which gets its view from the viewBase uniform. The
+// calls do not grow with the ranges, so thousands of curves cost what one does.
+void multiDraw(GLenum mode, GLuint viewBase)
+{
+	GLsizei draws = drawFirsts.size();
+	if (draws == 0) {
+		return;
+	}
+	if (multiDrawIndirect) {
+		drawCommands.resize(draws);
+		for (GLsizei i = 0; i < draws; i++) {
+			DrawArraysIndirectCommand command = { (GLuint)drawCounts[i], (GLuint)numViews(), (GLuint)drawFirsts[i], 0 };
+			drawCommands[i] = command;
 		}
-		else {
-			b = i - 1;
-		}
-
-		float w = 0.2; // t value
-		float x1T = w * (p[a].XYZW[0] - p[b].XYZW[0]); // x1 tangent, ci0
-		float y1T = w * (p[a].XYZW[1] - p[b].XYZW[1]); // y1 tangent
-		float x2T = w * (p[e].XYZW[0] - p[i].XYZW[0]); // x2 tangent, ci3
-		float y2T = w * (p[e].XYZW[1] - p[i].XYZW[1]); // y2 tangent
-
-		// Calc c0,c1,c2,c3 xy
-		x0 = p[i].XYZW[0];
-		y0 = p[i].XYZW[1];
-		x3 = p[a].XYZW[0];
-		y3 = p[a].XYZW[1];
-		x1 = x0 + x1T;
-		y1 = y0 + y1T;
-		x2 = x3 - x2T;
-		y2 = y3 - y2T;
-
-		// Set xy and color for c0,c1,c2,c3
-		float newCoords0[] = { x0, y0, 0.0f, 1.0f };
-		c[4 * i].SetCoords(newCoords0);
-		c[4 * i].SetColor(CRptColor);
-		float newCoords1[] = { x1, y1, 0.0f, 1.0f };
-		c[4 * i + 1].SetCoords(newCoords1);
-		c[4 * i + 1].SetColor(CRptColor);
-		float newCoords2[] = { x2, y2, 0.0f, 1.0f };
-		c[4 * i + 2].SetCoords(newCoords2);
-		c[4 * i + 2].SetColor(CRptColor);
-		float newCoords3[] = { x3, y3, 0.0f, 1.0f };
-		c[4 * i + 3].SetCoords(newCoords3);
-		c[4 * i + 3].SetColor(CRptColor);
-	}
-}
-
-void CatmullRomCurves(const Vertex* pcr, Vertex* curve) {
-	
-	Vertex temp[40]; // temporary array to hold data from calc
-	float x, y, t;
-
-	for (int i = 0; i < IndexCount; i++) {
-		for (int j = 0; j < 15; j++) {
-			// copy bezier points from PCR into temp array
-			for (int k = 0; k < 40; k++) {
-				temp[k] = pcr[k];
-			}
-			// calc curve using decasteljau
-			for (int a = 1; a < 4; a++) {
-				for (int b = 0; b < 4 - a; b++) {
-					// calc x,y
-					t = j / 15.0f;
-					x = (1.0f - t) * temp[4 * i + b].XYZW[0] + t * temp[4 * i + b + 1].XYZW[0];	
-					y = (1.0f - t) * temp[4 * i + b].XYZW[1] + t * temp[4 * i + b + 1].XYZW[1];	
-					// set xy and color for curve
-					float newCoords[] = { x, y, 0.0f, 1.0f };
-					temp[4 * i + b].SetCoords(newCoords);
-					temp[4 * i + b].SetColor(CRcurveColor);	
-				}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, IndirectBufferId);
+		// orphaned, so filling it never waits for the last draw to read it
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, draws * sizeof(DrawArraysIndirectCommand), &drawCommands[0], GL_STREAM_DRAW);
+		glMultiDrawArraysIndirect(mode, 0, draws, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		frameDrawCalls++;
+		return;
+	}
+	for (int view = 0; view < numViews(); view++) {
+		glUniform1i(viewBase, view);
+		glMultiDrawArrays(mode, &drawFirsts[0], &drawCounts[0], draws);
+		frameDrawCalls++;
+	}
+	glUniform1i(viewBase, 0);
+}
+
+// where curve c of set s lies in ObjectId's vertices
+void objectRange(const CurveSet& s, int ObjectId, int c, GLint* first, GLsizei* count)
+{
+	const SceneCurve& curve = s.curves[c];
+	if (ObjectId == 0) {
+		*first = curve.first;
+		*count = curve.count;
+	}
+	else if (ObjectId <= MaxLevel) {
+		// each subdivision level doubles every curve
+		*first = curve.first << ObjectId;
+		*count = curve.count << ObjectId;
+	}
+	else if (ObjectId == 6 || ObjectId == 7) {
+		// 4 Bezier points per segment
+		*first = 4 * curve.first;
+		*count = 4 * curve.count;
+	}
+	else if (ObjectId == 8) {
+		// as many points per segment as the tessellation gave it
+		*first = s.segmentFirst[curve.first];
+		*count = s.segmentFirst[curve.first + curve.count] - *first;
+	}
+	else {
+		// one looping dot per curve
+		*first = c;
+		*count = 1;
+	}
+}
+
+// the cheapest variant that draws mode: only surfaces are lit, and only points need a size
+ShadeVariant shadeVariant(GLenum mode)
+{
+	if (mode == GL_POINTS) {
+		return ShadePoints;
+	}
+	if (mode == GL_TRIANGLES || mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) {
+		return ShadeLit;
+	}
+	return ShadeFlat;
+}
+
+// Use the variant for mode, drawing in color, or in the vertices' own colours if
+// that is NULL. The program is only switched when the variant changes.
+ShadeProgram& useShade(GLenum mode, const float* color)
+{
+	ShadeVariant variant = shadeVariant(mode);
+	ShadeProgram& p = shadePrograms[variant];
+	if (shadeInUse != variant) {
+		glUseProgram(p.id);
+		shadeInUse = variant;
+		if (variant == ShadeLit) {
+			glUniformMatrix4fv(p.ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
+			glm::vec3 lightPos = glm::vec3(4, 4, 4);
+			glUniform3f(p.LightID, lightPos.x, lightPos.y, lightPos.z);
+		}
+	}
+	glUniform1i(p.VertexColorsID, color == NULL);
+	if (color) {
+		glUniform4fv(p.ObjectColorID, 1, color);
+	}
+	return p;
+}
+
+// Draw every curve of one object, once per view; the vertex shader picks the
+// view's matrices from the Views uniform block with ViewBase + gl_InstanceID.
+void drawObject(const CurveSet& s, int ObjectId, GLenum mode)
+{
+	ShadeProgram& p = useShade(mode, ObjectColor[ObjectId]);
+	if (IndexBufferId[ObjectId]) {
+		glDrawElementsInstanced(mode, NumVert[ObjectId], GL_UNSIGNED_INT, (void*)0, numViews());
+		frameDrawCalls++;
+		return;
+	}
+	drawFirsts.resize(s.curves.size());
+	drawCounts.resize(s.curves.size());
+	for (size_t c = 0; c < s.curves.size(); c++) {
+		objectRange(s, ObjectId, c, &drawFirsts[c], &drawCounts[c]);
+	}
+	multiDraw(mode, p.ViewBaseID);
+}
+
+// draw the pieces of direct subdivision gathered in directChunk, and start a new chunk
+void flushDirect(size_t used)
+{
+	// orphan, so the next chunk never waits for this one to be drawn
+	glBufferData(GL_ARRAY_BUFFER, (DirectChunk + 1) * sizeof(CurveVertex), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, used * sizeof(CurveVertex), directChunk.data);
+	frameUploadBytes += used * sizeof(CurveVertex);
+	frameUploads++;
+	multiDraw(GL_LINE_STRIP, useShade(GL_LINE_STRIP, subdivideColor).ViewBaseID);
+	// each piece ends on the first point of the next, which is not drawn twice
+	for (size_t i = 0; i < drawCounts.size(); i++) {
+		drawCounts[i]--;
+	}
+	multiDraw(GL_POINTS, useShade(GL_POINTS, subdivideColor).ViewBaseID);
+	drawFirsts.clear();
+	drawCounts.clear();
+}
+
+// Stream subdivision level s.directLevel through DirectBufferId: each chunk is
+// evaluated from the set's control points, uploaded and drawn before the next,
+// so the level is never held whole. Curves stop at the level where their edges
+// are a pixel long, so a deep level costs what the screen can show, not 2^level. A chunk holds pieces of as many curves as
+// fit, each drawn as its own strip; pieces share their end point so the strips join.
+void drawDirect(const CurveSet& s)
+{
+	glBindVertexArray(DirectVertexArrayId);
+	glBindBuffer(GL_ARRAY_BUFFER, DirectBufferId);
+	drawFirsts.clear();
+	drawCounts.clear();
+	size_t used = 0;
+	directLevelDrawn = 0;
+	for (size_t c = 0; c < s.curves.size(); c++) {
+		const Vertex* p = s.points.data + s.curves[c].first;
+		int n = s.curves[c].count;
+		int level = s.directLevels[c];
+		directLevelDrawn = std::max(directLevelDrawn, level);
+		size_t total = (size_t)n << level;
+		for (size_t first = 0; first < total; ) {
+			if (DirectChunk + 1 - used < 2) {
+				flushDirect(used);
+				used = 0;
 			}
-			// copy data from temp array to PD VAO
-			curve[(15 * i) + j].SetCoords(temp[4 * i].XYZW);
-			curve[(15 * i) + j].SetColor(CRcurveColor);
+			size_t last = first + (DirectChunk - used) < total ? first + (DirectChunk - used) : total;
+			// the last piece closes the loop back to point 0
+			SubdivisionDirect(p, n, level, s.directLimit, first, last + 1, directChunk.data + used);
+			drawFirsts.push_back(used);
+			drawCounts.push_back(last - first + 1);
+			used += last - first + 1;
+			first = last;
 		}
 	}
+	if (used > 0) {
+		flushDirect(used);
+	}
+	glBindVertexArray(0);
+}
+
+// the curve of every control point of s as (first, count), for the GPU curves
+void uploadCurveRanges(const CurveSet& s)
+{
+	if (rangesVersion == s.curvesVersion && rangesPoints == s.builtPoints) {
+		return;
+	}
+	curveRanges.resize(2 * curvesEnd(s));
+	for (size_t c = 0; c < s.curves.size(); c++) {
+		for (uint32_t i = s.curves[c].first; i < s.curves[c].first + s.curves[c].count; i++) {
+			curveRanges[2 * i] = s.curves[c].first;
+			curveRanges[2 * i + 1] = s.curves[c].count;
+		}
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, CurveRangesBufferId);
+	glBufferData(GL_TEXTURE_BUFFER, curveRanges.bytes(), curveRanges.data, GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	frameUploadBytes += curveRanges.bytes();
+	frameUploads++;
+	rangesVersion = s.curvesVersion;
+	rangesPoints = s.builtPoints;
+}
+
+// Draw a curve evaluated in the vertex shader for every curve of s; scheme 0 is Bezier, 1 Catmull-Rom.
+// samples 0 draws the segments' Bezier control points instead of the curve. curveProgramID must be in use.
+void drawCurve(const CurveSet& s, GLenum mode, int scheme, int samples, float* color)
+{
+	glUniform1i(SchemeID, scheme);
+	glUniform1i(SamplesID, samples);
+	glUniform4fv(CurveColorID, 1, color);
+	int perSegment = samples > 0 ? samples : 4;
+	drawFirsts.resize(s.curves.size());
+	drawCounts.resize(s.curves.size());
+	for (size_t c = 0; c < s.curves.size(); c++) {
+		drawFirsts[c] = perSegment * s.curves[c].first;
+		drawCounts[c] = perSegment * s.curves[c].count;
+	}
+	multiDraw(mode, CurveViewBaseID);
 }
 
 void drawScene(void)
 {
+	ProfileBegin(PhaseDraw, true);
 	// Dark blue background
 	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 	// Re-clear the screen for real rendering
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glUseProgram(programID);
+	// whatever ran since the last frame may have left another program in use
+	shadeInUse = -1;
 	{
-		glm::mat4 ModelMatrix = glm::mat4(1.0); // TranslationMatrix * RotationMatrix;
-		glm::mat4 ModelMatrix2 = glm::mat4(1.0);  // Second ModelMatrix for Translation
-		glm::mat4 MVP;
-		glm::mat4 MVP2;
-		if (splitView) {
-			// Scale ModelMatrix
-			ModelMatrix = glm::scale(ModelMatrix,glm::vec3(0.8f));
-			// Translate ModelMatrix2 Downwards from Origin
-			ModelMatrix2 = glm::translate(ModelMatrix,glm::vec3(0.0f, -2.0f, 0.0f));
-		    // Translate ModelMatrix Upwards from Origin
-			ModelMatrix = glm::translate(ModelMatrix,glm::vec3(0.0f, 2.0f, 0.0f));
-		    // Rotate ModelMatrix2 Around Y Axis by PI/2 for side view
-			ModelMatrix2 = glm::rotate(ModelMatrix2,float(PI / 2),glm::vec3(0.0f, 1.0f, 0.0f));
-		}
-		MVP = gProjectionMatrix * gViewMatrix * ModelMatrix;
-		MVP2 = gProjectionMatrix * gViewMatrix * ModelMatrix2;
-
-		// Send our transformation to the currently bound shader, 
-		// in the "MVP" uniform
-		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glm::vec3 lightPos = glm::vec3(4, 4, 4);
-		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
-		
+		// per-view MVP and M matrices, laid out as the std140 Views block: ViewMVP[MaxViews] then ViewM[MaxViews]
+		glm::mat4 views[2 * MaxViews];
+		for (int view = 0; view < numViews(); view++) {
+			glm::mat4 ModelMatrix = viewModelMatrix(view);
+			views[view] = gProjectionMatrix * gViewMatrix * ModelMatrix;
+			views[MaxViews + view] = ModelMatrix;
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, ViewsBufferId);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(views), &views[0][0][0]);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
 		glEnable(GL_PROGRAM_POINT_SIZE);
 
 		glBindVertexArray(VertexArrayId[0]);	// draw Vertices
-		glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[0]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertices), Vertices);				// update buffer data
-		glDrawElements(GL_LINE_LOOP, NumVert[0], GL_UNSIGNED_SHORT, (void*)0);
-		glDrawElements(GL_POINTS, NumVert[0], GL_UNSIGNED_SHORT, (void*)0);
+		uploadObject(0, Vertices);
+		// the curves come from the front set, as they were when it was built,
+		// and so does the object table, even for the control points
+		CurveSet& s = *front;
+		drawObject(s, 0, GL_LINE_LOOP);
+		drawObject(s, 0, GL_POINTS);
 		// ATTN: OTHER BINDING AND DRAWING COMMANDS GO HERE, one set per object:
 		//glBindVertexArray(VertexArrayId[<x>]); etc etc
-		if (pressed == 1) {
-			if (count == 1) {
-				glBindVertexArray(VertexArrayId[1]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[1]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision1), subdivision1);
-				glDrawElements(GL_LINE_LOOP, NumVert[1], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[1], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-			}
-			if (count == 2) {
-				glBindVertexArray(VertexArrayId[2]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[2]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision2), subdivision2);
-				glDrawElements(GL_LINE_LOOP, NumVert[2], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[2], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-			}
-			if (count == 3) {
-				glBindVertexArray(VertexArrayId[3]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[3]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision3), subdivision3);
-				glDrawElements(GL_LINE_LOOP, NumVert[3], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[3], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-			}
-			if (count == 4) {
-				glBindVertexArray(VertexArrayId[4]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[4]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision4), subdivision4);
-				glDrawElements(GL_LINE_LOOP, NumVert[4], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[4], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-			}
-			if (count == 5) {
-				glBindVertexArray(VertexArrayId[5]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[5]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision5), subdivision5);
-				glDrawElements(GL_LINE_LOOP, NumVert[5], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[5], GL_UNSIGNED_SHORT, (void*)0);
+		if (s.pressed == 1 && s.direct) {
+			drawDirect(s);
+		}
+		else if (s.pressed == 1) {
+			if (s.count >= 1 && s.count <= MaxLevel) {
+				glBindVertexArray(VertexArrayId[s.count]);
+				uploadObject(s.count, s.subdivision[s.count]);
+				drawObject(s, s.count, GL_LINE_LOOP);
+				drawObject(s, s.count, GL_POINTS);
 				glBindVertexArray(0);
 			}
 		}
-		if (pressed == 2) {
+		if (s.pressed == 2 && !s.gpuCurves) {
 			glBindVertexArray(VertexArrayId[6]);
-			glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[6]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(beziercurve), beziercurve);
-			glDrawElements(GL_LINE_LOOP, NumVert[6], GL_UNSIGNED_SHORT, (void*)0);
-			glDrawElements(GL_POINTS, NumVert[6], GL_UNSIGNED_SHORT, (void*)0);
+			uploadObject(6, s.beziercurve);
+			drawObject(s, 6, GL_LINE_LOOP);
+			drawObject(s, 6, GL_POINTS);
 			glBindVertexArray(0);
 		}
-		if (pressed == 3) {
+		if (s.pressed == 3 && !s.gpuCurves) {
 			glBindVertexArray(VertexArrayId[7]);
-			glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[7]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(catmullrom), catmullrom);
-			glDrawElements(GL_LINE_LOOP, NumVert[7], GL_UNSIGNED_SHORT, (void*)0);
-			glDrawElements(GL_POINTS, NumVert[7], GL_UNSIGNED_SHORT, (void*)0);
+			uploadObject(7, s.catmullromXY);
+			drawObject(s, 7, GL_LINE_LOOP);
+			drawObject(s, 7, GL_POINTS);
 			glBindVertexArray(0);
 
 			glBindVertexArray(VertexArrayId[8]);
-			glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[8]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(decastel), decastel);
-			glDrawElements(GL_LINE_LOOP, NumVert[8], GL_UNSIGNED_SHORT, (void*)0);
+			uploadObject(8, s.decastel);
+			curveVertices = s.decastel.count;
+			drawObject(s, 8, GL_LINE_LOOP);
 			glBindVertexArray(0);
 		}
-		if (loop) {
+		if (s.loop) {
 			glBindVertexArray(VertexArrayId[9]);
-			glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[9]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(dotloop), dotloop);
-			glDrawElements(GL_POINTS, NumVert[9], GL_UNSIGNED_SHORT, (void*)0);
+			uploadObject(9, s.dotloop);
+			drawObject(s, 9, GL_POINTS);
 		}
 		glBindVertexArray(0);
-
-		if (splitView) {
-			glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP2[0][0]);
-			glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix2[0][0]);
-			glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-			glm::vec3 lightPos = glm::vec3(4, 4, 4);
-			glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
-
-			glEnable(GL_PROGRAM_POINT_SIZE);
-
-			glBindVertexArray(VertexArrayId[0]);	// draw Vertices
-			glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[0]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertices), Vertices);
-			glDrawElements(GL_LINE_LOOP, NumVert[0], GL_UNSIGNED_SHORT, (void*)0);
-			glDrawElements(GL_POINTS, NumVert[0], GL_UNSIGNED_SHORT, (void*)0);
-
-			if (pressed == 1) {
-				if (count == 1) {
-					glBindVertexArray(VertexArrayId[1]);
-					glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[1]);
-					glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision1), subdivision1);
-					glDrawElements(GL_LINE_LOOP, NumVert[1], GL_UNSIGNED_SHORT, (void*)0);
-					glDrawElements(GL_POINTS, NumVert[1], GL_UNSIGNED_SHORT, (void*)0);
-					glBindVertexArray(0);
-				}
-				if (count == 2) {
-					glBindVertexArray(VertexArrayId[2]);
-					glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[2]);
-					glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision2), subdivision2);
-					glDrawElements(GL_LINE_LOOP, NumVert[2], GL_UNSIGNED_SHORT, (void*)0);
-					glDrawElements(GL_POINTS, NumVert[2], GL_UNSIGNED_SHORT, (void*)0);
-					glBindVertexArray(0);
-				}
-				if (count == 3) {
-					glBindVertexArray(VertexArrayId[3]);
-					glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[3]);
-					glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision3), subdivision3);
-					glDrawElements(GL_LINE_LOOP, NumVert[3], GL_UNSIGNED_SHORT, (void*)0);
-					glDrawElements(GL_POINTS, NumVert[3], GL_UNSIGNED_SHORT, (void*)0);
-					glBindVertexArray(0);
-				}
-				if (count == 4) {
-					glBindVertexArray(VertexArrayId[4]);
-					glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[4]);
-					glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision4), subdivision4);
-					glDrawElements(GL_LINE_LOOP, NumVert[4], GL_UNSIGNED_SHORT, (void*)0);
-					glDrawElements(GL_POINTS, NumVert[4], GL_UNSIGNED_SHORT, (void*)0);
-					glBindVertexArray(0);
-				}
-				if (count == 5) {
-					glBindVertexArray(VertexArrayId[5]);
-					glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[5]);
-					glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(subdivision5), subdivision5);
-					glDrawElements(GL_LINE_LOOP, NumVert[5], GL_UNSIGNED_SHORT, (void*)0);
-					glDrawElements(GL_POINTS, NumVert[5], GL_UNSIGNED_SHORT, (void*)0);
-					glBindVertexArray(0);
-				}
-			}
-			if (pressed == 2) {
-				glBindVertexArray(VertexArrayId[6]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[6]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(beziercurve), beziercurve);
-				glDrawElements(GL_LINE_LOOP, NumVert[6], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[6], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-			}
-			if (pressed == 3) {
-				glBindVertexArray(VertexArrayId[7]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[7]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(catmullrom), catmullrom);
-				glDrawElements(GL_LINE_LOOP, NumVert[7], GL_UNSIGNED_SHORT, (void*)0);
-				glDrawElements(GL_POINTS, NumVert[7], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-
-				glBindVertexArray(VertexArrayId[8]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[8]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(decastel), decastel);
-				glDrawElements(GL_LINE_LOOP, NumVert[8], GL_UNSIGNED_SHORT, (void*)0);
-				glBindVertexArray(0);
-			}
-			if (loop) {
-				glBindVertexArray(VertexArrayId[9]);
-				glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[9]);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(dotloop), dotloop);
-				glDrawElements(GL_POINTS, NumVert[9], GL_UNSIGNED_SHORT, (void*)0);
-			}
-			glBindVertexArray(0);
+	}
+	CurveSet& s = *front;
+	if (s.gpuCurves && (s.pressed == 2 || s.pressed == 3)) {
+		glUseProgram(curveProgramID);
+		uploadCurveRanges(s);
+		// the control points went up with object 0 above
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, ControlPointsTexture);
+		glUniform1i(ControlPointsID, 0);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_BUFFER, CurveRangesTexture);
+		glUniform1i(CurveRangesID, 1);
+		glBindVertexArray(CurveVertexArrayId);
+		if (s.pressed == 2) {
+			drawCurve(s, GL_LINE_LOOP, 0, 0, bezierColor);
+			drawCurve(s, GL_POINTS, 0, 0, bezierColor);
+		}
+		if (s.pressed == 3) {
+			drawCurve(s, GL_LINE_LOOP, 1, 0, CRptColor);
+			drawCurve(s, GL_POINTS, 1, 0, CRptColor);
+			drawCurve(s, GL_LINE_LOOP, 1, curveSamples, CRcurveColor);
 		}
+		glBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glUseProgram(0);
 	}
-	glUseProgram(0);
+	ProfileEnd();
 	// Draw GUI
+	ProfileBegin(PhaseGUI, true);
 	TwDraw();
+	ProfileEnd();
+}
 
+void swapBuffers(void)
+{
+	if (headless) {
+		HeadlessSwapBuffers();
+		return;
+	}
 	// Swap buffers
 	glfwSwapBuffers(window);
 	glfwPollEvents();
 }
 
-void pickVertex(void)
+// something on screen changed: draw the next frames, until the change is shown
+void damage(void)
 {
-	// Clear the screen in white
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	damagedFrames = PipelineFrames;
+}
 
-	glUseProgram(pickingProgramID);
-	{
-		glm::mat4 ModelMatrix = glm::mat4(1.0); // TranslationMatrix * RotationMatrix;
-		if (splitView) {
-			// Scale Matrix
-			ModelMatrix = glm::scale(ModelMatrix,glm::vec3(0.8f));
-			// Translate Matrix
-			ModelMatrix = glm::translate(ModelMatrix,glm::vec3(0.0f, 2.0f, 0.0f));
+// On demand, sleep until there is a change to draw, handling the input that
+// comes in meanwhile. Only a pick or a scene file still being read in wakes it
+// without an event, as nothing reports when those are done.
+void waitForDamage(void)
+{
+	while (onDemand && !loop && damagedFrames == 0 && !glfwWindowShouldClose(window)) {
+		if (pickFence || sceneStreaming) {
+			glfwWaitEventsTimeout(WakeInterval);
+		}
+		else {
+			glfwWaitEvents();
 		}
-		glm::mat4 MVP = gProjectionMatrix * gViewMatrix * ModelMatrix;
+		handleInput();
+		if (damagedFrames == 0) {
+			// the input changed nothing on screen, so there is no latency to time
+			inputStamp = -1.0;
+		}
+	}
+}
+
+// once a frame, and whenever waitForDamage() wakes up
+void handleInput(void)
+{
+	// draw whatever more of a scene file has been read in
+	streamScene();
+	// the cursor, for a recording; the clicks and keys come in through the callbacks
+	double xpos, ypos;
+	cursorPos(&xpos, &ypos);
+	InputRecordCursor(xpos, ypos);
+	// PICKING: finish a click whose ID read has come back
+	pollPick();
+
+	// DRAGGING: move current (picked) vertex to where the cursor is now,
+	// however many moves it took to get there
+	if (isChanged && cursorMoved && leftButtonDown()) {
+		moveVertex();
+		cursorMoved = false;
+	}
+}
+
+// an input event came in
+void stampInput(void)
+{
+	if (inputStamp < 0.0) {
+		inputStamp = benchNow();
+	}
+}
+
+// the events so far are handled by the frame being made
+void inputHandled(void)
+{
+	for (int i = PipelineFrames - 1; i > 0; i--) {
+		handledStamps[i] = handledStamps[i - 1];
+	}
+	handledStamps[0] = inputStamp;
+	inputStamp = -1.0;
+}
+
+// After a swap: ms since the oldest event whose effect it shows came in, or -1
+// if it shows none. The events were handled PipelineFrames - 1 frames before.
+double frameSwapped(void)
+{
+	double stamp = handledStamps[PipelineFrames - 1];
+	handledStamps[PipelineFrames - 1] = -1.0;
+	if (stamp < 0.0) {
+		return -1.0;
+	}
+	inputLatency = float(1000.0 * (benchNow() - stamp));
+	return inputLatency;
+}
+
+// rebuild pickGrid if the view or the number of control points changed since it was built
+void updatePickGrid(void)
+{
+	glm::mat4 MVP = gProjectionMatrix * gViewMatrix * viewModelMatrix(0);
+	if (!pickGridBuilt || MVP != pickGridMVP || pickGrid.x.size() != Vertices.count) {
+		PickGridBuild(pickGrid, Vertices.data, Vertices.count, &MVP[0][0], window_width, window_height, PickRadius);
+		pickGridMVP = MVP;
+		pickGridBuilt = true;
+	}
+}
+
+// nearest control point to the cursor from the CPU grid, no GPU round trip
+GLuint pickCPU(double xpos, double ypos)
+{
+	updatePickGrid();
+	int k = PickGridNearest(pickGrid, xpos, ypos, PickRadius);
+	return k < 0 ? BackgroundIndex : k;
+}
 
+// render the pickable objects into the ID buffer, vertex i of an object as PickBase[object] + i
+void renderIDBuffer(glm::mat4& MVP)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, PickFramebufferId);
+	// the ID buffer keeps the size the window was made with
+	glViewport(0, 0, window_width, window_height);
+	// Clear the ID buffer to BackgroundIndex
+	glClearBufferuiv(GL_COLOR, 0, &BackgroundIndex);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glUseProgram(pickingProgramID);
+	{
 		// Send our transformation to the currently bound shader, in the "MVP" uniform
 		glUniformMatrix4fv(PickingMatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniform1fv(pickingColorArrayID, NumVert[0], pickingColor);	// here we pass in the picking marker array
 
-		// Draw the ponts
+		// Draw the ponts; only the control points are pickable so far
 		glEnable(GL_PROGRAM_POINT_SIZE);
+		GLuint base = 0;
+		PickBase[0] = base;
+		glUniform1ui(PickingBaseID, base);
 		glBindVertexArray(VertexArrayId[0]);
-		glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[0]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertices), Vertices);	// update buffer data
-		glDrawElements(GL_POINTS, NumVert[0], GL_UNSIGNED_SHORT, (void*)0);
+		uploadObject(0, Vertices);
+		glDrawArrays(GL_POINTS, 0, NumVert[0]);
 		glBindVertexArray(0);
+		base += NumVert[0];
 	}
 	glUseProgram(0);
-	// Wait until all the pending drawing commands are really done.
-	// Ultra-mega-over slow ! 
-	// There are usually a long time between glDrawElements() and
-	// all the fragments completely rasterized.
-	glFlush();
-	glFinish();
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	// Read the pixel at the center of the screen.
-	// You can also use glfwGetMousePos().
-	// Ultra-mega-over slow too, even for 1 pixel, 
-	// because the framebuffer is on the GPU.
-	double xpos, ypos;
-	glfwGetCursorPos(window, &xpos, &ypos);
-	unsigned char data[4];
-	glReadPixels(xpos, window_height - ypos, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, data); // OpenGL renders with (0,0) on bottom, mouse reports with (0,0) on top
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-	// Convert the color back to an integer ID
-	if (!isChanged) {
-		gPickedIndex = int(data[0]);
+	idBufferMVP = MVP;
+	idBufferDirty = false;
+}
+
+// start reading the IDs around the cursor; pollPick() picks them up once the GPU is done
+void startPickGPU(double xpos, double ypos)
+{
+	glm::mat4 MVP = gProjectionMatrix * gViewMatrix * viewModelMatrix(0);
+	if (idBufferDirty || MVP != idBufferMVP) {
+		renderIDBuffer(MVP);
 	}
-	if (gPickedIndex == 255) { // Full white, must be the background !
+
+	// OpenGL renders with (0,0) on bottom, mouse reports with (0,0) on top
+	int x = (int)xpos;
+	int y = window_height - 1 - (int)ypos;
+	int x0 = x - pickNeighbourhood < 0 ? 0 : x - pickNeighbourhood;
+	int y0 = y - pickNeighbourhood < 0 ? 0 : y - pickNeighbourhood;
+	int x1 = x + pickNeighbourhood >= (int)window_width ? window_width - 1 : x + pickNeighbourhood;
+	int y1 = y + pickNeighbourhood >= (int)window_height ? window_height - 1 : y + pickNeighbourhood;
+	if (x0 > x1 || y0 > y1) {
+		// cursor outside the window
+		pickedVertex(BackgroundIndex);
+		return;
+	}
+	pickRect[0] = x0;
+	pickRect[1] = y0;
+	pickRect[2] = x1 - x0 + 1;
+	pickRect[3] = y1 - y0 + 1;
+	pickCenter[0] = x;
+	pickCenter[1] = y;
+
+	// the read goes into the pixel buffer and returns at once
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, PickFramebufferId);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, PickPixelBufferId);
+	glReadPixels(pickRect[0], pickRect[1], pickRect[2], pickRect[3], GL_RED_INTEGER, GL_UNSIGNED_INT, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	if (pickFence) {
+		glDeleteSync(pickFence);
+	}
+	pickFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// the pick has been resolved: remember the point's colour and start dragging it
+void pickedVertex(GLuint index)
+{
+	pickLatency = float(1000.0 * (benchNow() - pickStartTime));
+	picksResolved++;
+	// the GUI shows what was picked
+	damage();
+	gPickedIndex = index;
+	if (gPickedIndex == BackgroundIndex) {
 		gMessage = "background";
+		return;
 	}
-	else {
-		if (!isChanged && gPickedIndex < IndexCount) {
-			pickedR = Vertices[gPickedIndex].RGBA[0];
-			pickedG = Vertices[gPickedIndex].RGBA[1];
-			pickedB = Vertices[gPickedIndex].RGBA[2];
-		}
+	std::ostringstream oss;
+	oss << "point " << gPickedIndex;
+	gMessage = oss.str();
+	// a GPU pick can land after the button was let go; then it only selects
+	if (gPickedIndex < Vertices.count && leftButtonDown()) {
+		pickedR = Vertices[gPickedIndex].RGBA[0];
+		pickedG = Vertices[gPickedIndex].RGBA[1];
+		pickedB = Vertices[gPickedIndex].RGBA[2];
 		isChanged = true;
+	}
+}
 
+void pickVertex(void)
+{
+	if (isChanged || pickFence) {
+		// still dragging, or the last click is still being read
+		return;
+	}
+	ProfileScope profile(PhasePick, true);
+	double xpos, ypos;
+	cursorPos(&xpos, &ypos);
+	pickStartTime = benchNow();
+	if (cpuPicking) {
+		pickedVertex(pickCPU(xpos, ypos));
+	}
+	else {
+		startPickGPU(xpos, ypos);
+	}
+}
+
+// called every frame: finish a GPU pick once its read has landed in the pixel buffer
+void pollPick(void)
+{
+	if (!pickFence) {
+		return;
+	}
+	// a replay waits for it, so the drag starts on the same frame every run
+	GLuint64 timeout = replaying ? ReplayPickWait : 0;
+	if (glClientWaitSync(pickFence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout) == GL_TIMEOUT_EXPIRED) {
+		return;
+	}
+	ProfileScope profile(PhasePick);
+	glDeleteSync(pickFence);
+	pickFence = 0;
+
+	// nearest non-background texel to the cursor
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, PickPixelBufferId);
+	const GLuint* data = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pickRect[2] * pickRect[3] * sizeof(GLuint), GL_MAP_READ_BIT);
+	GLuint id = BackgroundIndex;
+	int best = 0;
+	if (data) {
+		for (int j = 0; j < pickRect[3]; j++) {
+			for (int i = 0; i < pickRect[2]; i++) {
+				GLuint texel = data[j * pickRect[2] + i];
+				if (texel == BackgroundIndex) {
+					continue;
+				}
+				int dx = pickRect[0] + i - pickCenter[0];
+				int dy = pickRect[1] + j - pickCenter[1];
+				if (id == BackgroundIndex || dx * dx + dy * dy < best) {
+					id = texel;
+					best = dx * dx + dy * dy;
+				}
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	// back from pick ID to control point index
+	if (id != BackgroundIndex && id - PickBase[0] < NumVert[0]) {
+		pickedVertex(id - PickBase[0]);
+	}
+	else {
+		pickedVertex(BackgroundIndex);
 	}
-	// Uncomment these lines to see the picking shader in effect
-	//glfwSwapBuffers(window);
-	//continue; // skips the normal rendering
 }
 
 // fill this function in!
 void moveVertex(void)
 {
-	glm::mat4 ModelMatrix = glm::mat4(1.0);
-	if (splitView) {
-		// Scale Matrix
-		ModelMatrix = glm::scale(ModelMatrix,glm::vec3(0.8f));
-		// Translate Matrix
-		ModelMatrix = glm::translate(ModelMatrix,glm::vec3(0.0f, 2.0f, 0.0f));
-	}
+	glm::mat4 ModelMatrix = viewModelMatrix(0);
 
-	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
 	glm::vec4 vp = glm::vec4(viewport[0], viewport[1], viewport[2], viewport[3]);
 	// retrieve your cursor position
 	// get your world coordinates
 	// move points
 	if (isChanged) {
 		double xpos, ypos;
-		glfwGetCursorPos(window, &xpos, &ypos);
+		cursorPos(&xpos, &ypos);
 		glm::vec3 mouseLoc = glm::unProject(glm::vec3(window_width - xpos, window_height - ypos, 0.0), ModelMatrix, gProjectionMatrix, vp);
 		if (!zPick) {
-			if (gPickedIndex < IndexCount) {
-				Vertices[gPickedIndex].XYZW[0] = mouseLoc[0];
-				Vertices[gPickedIndex].XYZW[1] = mouseLoc[1];
-				Vertices[gPickedIndex].SetColor(xypickColor);
-			}
+			moveVertexTo(gPickedIndex, mouseLoc[0], mouseLoc[1]);
 		}
 		else {
-			if (gPickedIndex < IndexCount) {
+			if (gPickedIndex < Vertices.count) {
+				if (Vertices[gPickedIndex].XYZW[2] != mouseLoc[1]) {
+					damage();
+				}
 				Vertices[gPickedIndex].XYZW[2] = mouseLoc[1]; // z translate when mouse moves up and down
 				Vertices[gPickedIndex].SetColor(zpickColor);
+				markObjectDirty(0, gPickedIndex, gPickedIndex + 1);
+				if (pickGridBuilt) {
+					PickGridMove(pickGrid, Vertices.data, gPickedIndex);
+				}
 			}
 		}
 		
 	}
 
 	
-	if (gPickedIndex == 255){ // Full white, must be the background !
+	if (gPickedIndex == BackgroundIndex){
 		gMessage = "background";
 	}
 	else {
@@ -751,6 +1600,26 @@ void moveVertex(void)
 	}
 }
 
+// move control point k in the XY plane and mark everything that depends on it
+void moveVertexTo(GLuint k, float x, float y)
+{
+	if (k >= Vertices.count) {
+		return;
+	}
+	// the curves only need redoing around this point, and only if it really moved
+	if (Vertices[k].XYZW[0] != x || Vertices[k].XYZW[1] != y) {
+		markDirty(k);
+		damage();
+	}
+	Vertices[k].XYZW[0] = x;
+	Vertices[k].XYZW[1] = y;
+	Vertices[k].SetColor(xypickColor);
+	markObjectDirty(0, k, k + 1);
+	if (pickGridBuilt) {
+		PickGridMove(pickGrid, Vertices.data, k);
+	}
+}
+
 int initWindow(void)
 {
 	// Initialise GLFW
@@ -781,24 +1650,82 @@ int initWindow(void)
 		return -1;
 	}
 
-	// Initialize the GUI
-	TwInit(TW_OPENGL_CORE, NULL);
-	TwWindowSize(window_width, window_height);
-	TwBar * GUI = TwNewBar("Picking");
-	TwSetParam(GUI, NULL, "refresh", TW_PARAM_CSTRING, 1, "0.1");
-	TwAddVarRW(GUI, "Last picked object", TW_TYPE_STDSTRING, &gMessage, NULL);
+	initGUI();
 
 	// Set up inputs
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_FALSE);
 	glfwSetCursorPos(window, window_width / 2, window_height / 2);
 	glfwSetMouseButtonCallback(window, mouseCallback);
 	glfwSetKeyCallback(window, keyCallback);
+	glfwSetWindowRefreshCallback(window, refreshCallback);
+	glfwSetCursorPosCallback(window, cursorCallback);
+	glfwSetFramebufferSizeCallback(window, resizeCallback);
+
+	return 0;
+}
+
+// offscreen context for the benchmark mode, no window and no input
+int initHeadless(void)
+{
+	if (!HeadlessInit(window_width, window_height)) {
+		return -1;
+	}
+	headless = true;
+
+	// Initialize GLEW; glewInit() would also want a GLX display, so load the GL entry points only
+	glewExperimental = true; // Needed for core profile
+	if (glewContextInit() != GLEW_OK) {
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		return -1;
+	}
 
+	initGUI();
 	return 0;
 }
 
+void initGUI(void)
+{
+	// Initialize the GUI
+	TwInit(TW_OPENGL_CORE, NULL);
+	TwWindowSize(window_width, window_height);
+	TwBar * GUI = TwNewBar("Picking");
+	TwSetParam(GUI, NULL, "refresh", TW_PARAM_CSTRING, 1, "0.1");
+	TwAddVarRW(GUI, "Last picked object", TW_TYPE_STDSTRING, &gMessage, NULL);
+	TwAddVarRO(GUI, "Upload bytes/frame", TW_TYPE_UINT32, &uploadBytesPerFrame, NULL);
+	TwAddVarRO(GUI, "Uploads/frame", TW_TYPE_UINT32, &uploadsPerFrame, NULL);
+	TwAddVarRO(GUI, "Draw calls/frame", TW_TYPE_UINT32, &drawCallsPerFrame, NULL);
+	TwAddVarRO(GUI, "Draw on demand", TW_TYPE_BOOLCPP, &onDemand, NULL);
+	TwAddVarRW(GUI, "GPU curves", TW_TYPE_BOOLCPP, &gpuCurves, NULL);
+	TwAddVarRW(GUI, "GPU curve samples", TW_TYPE_INT32, &curveSamples, " min=1 max=1024 ");
+	TwAddVarRW(GUI, "Curve tolerance (px)", TW_TYPE_FLOAT, &curveTolerance, " min=0.05 max=16 step=0.05 ");
+	TwAddVarRO(GUI, "Curve vertices", TW_TYPE_UINT32, &curveVertices, NULL);
+	TwAddVarRW(GUI, "Loop speed", TW_TYPE_FLOAT, &loopSpeed, " min=0 max=20 step=0.1 ");
+	TwAddVarRW(GUI, "CPU picking", TW_TYPE_BOOLCPP, &cpuPicking, NULL);
+	TwAddVarRW(GUI, "Direct subdivision", TW_TYPE_BOOLCPP, &directSubdivision, NULL);
+	TwAddVarRW(GUI, "Direct level", TW_TYPE_INT32, &directLevel, " min=1 max=24 ");
+	TwAddVarRO(GUI, "Direct level drawn", TW_TYPE_INT32, &directLevelDrawn, NULL);
+	TwAddVarRW(GUI, "Limit curve", TW_TYPE_BOOLCPP, &directLimit, NULL);
+	TwAddVarRW(GUI, "Pick neighbourhood", TW_TYPE_INT32, &pickNeighbourhood, " min=0 max=16 ");
+	TwAddVarRO(GUI, "Pick latency (ms)", TW_TYPE_FLOAT, &pickLatency, NULL);
+	TwAddVarRO(GUI, "Input latency (ms)", TW_TYPE_FLOAT, &inputLatency, NULL);
+
+	// live per-phase frame breakdown, in ms
+	for (int p = 0; p < NumProfilePhases; p++) {
+		std::string name = std::string("CPU ") + ProfilePhaseNames[p];
+		TwAddVarRO(GUI, name.c_str(), TW_TYPE_FLOAT, &ProfileAverageCPU[p], " group=CPU precision=3 ");
+	}
+	const ProfilePhase gpuPhases[] = { PhaseDraw, PhasePick, PhaseGUI };
+	for (int i = 0; i < 3; i++) {
+		std::string name = std::string("GPU ") + ProfilePhaseNames[gpuPhases[i]];
+		TwAddVarRO(GUI, name.c_str(), TW_TYPE_FLOAT, &ProfileAverageGPU[gpuPhases[i]], " group=GPU precision=3 ");
+	}
+}
+
 void initOpenGL(void)
 {
+	// the window's size until resizeCallback() says otherwise
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
 	// Dark blue background
 	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
@@ -822,49 +1749,141 @@ void initOpenGL(void)
 		);
 
 	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders("hw1bShade.vertexshader", "hw1bShade.fragmentshader");
+	for (int variant = 0; variant < NumShadeVariants; variant++) {
+		shadePrograms[variant].id = LoadShaderVariant("hw1bShade.vertexshader", "hw1bShade.fragmentshader", ShadeDefines[variant]);
+	}
 	pickingProgramID = LoadShaders("hw1bPick.vertexshader", "hw1bPick.fragmentshader");
-
-	// Get a handle for our "MVP" uniform
-	MatrixID = glGetUniformLocation(programID, "MVP");
-	ViewMatrixID = glGetUniformLocation(programID, "V");
-	ModelMatrixID = glGetUniformLocation(programID, "M");
+	curveProgramID = LoadShaders("hw1bCurve.vertexshader", "hw1bCurve.fragmentshader");
+
+	// Handles for each shading variant; the lit one also has a "V" and a "LightPosition" uniform
+	for (int variant = 0; variant < NumShadeVariants; variant++) {
+		ShadeProgram& p = shadePrograms[variant];
+		p.ViewMatrixID = glGetUniformLocation(p.id, "V");
+		p.LightID = glGetUniformLocation(p.id, "LightPosition_worldspace");
+		p.ViewBaseID = glGetUniformLocation(p.id, "ViewBase");
+		// the per-object colour of CurveVertex objects
+		p.ObjectColorID = glGetUniformLocation(p.id, "ObjectColor");
+		p.VertexColorsID = glGetUniformLocation(p.id, "VertexColors");
+		// per-view MVP and M matrices live in a uniform buffer on binding point 0
+		glUniformBlockBinding(p.id, glGetUniformBlockIndex(p.id, "Views"), 0);
+	}
+	glGenBuffers(1, &ViewsBufferId);
+	glBindBuffer(GL_UNIFORM_BUFFER, ViewsBufferId);
+	glBufferData(GL_UNIFORM_BUFFER, 2 * MaxViews * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, ViewsBufferId);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	PickingMatrixID = glGetUniformLocation(pickingProgramID, "MVP");
-	// Get a handle for our "pickingColorID" uniform
-	pickingColorArrayID = glGetUniformLocation(pickingProgramID, "PickingColorArray");
-	pickingColorID = glGetUniformLocation(pickingProgramID, "PickingColor");
-	// Get a handle for our "LightPosition" uniform
-	LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
-
-	createVAOs(Vertices, Indices, sizeof(Vertices), sizeof(Indices), 0);
+	// Get a handle for our "PickingBase" uniform
+	PickingBaseID = glGetUniformLocation(pickingProgramID, "PickingBase");
+	// Handles for the GPU curve program, which shares the Views block
+	glUniformBlockBinding(curveProgramID, glGetUniformBlockIndex(curveProgramID, "Views"), 0);
+	ControlPointsID = glGetUniformLocation(curveProgramID, "ControlPoints");
+	CurveRangesID = glGetUniformLocation(curveProgramID, "CurveRanges");
+	CurveViewBaseID = glGetUniformLocation(curveProgramID, "ViewBase");
+	SchemeID = glGetUniformLocation(curveProgramID, "Scheme");
+	SamplesID = glGetUniformLocation(curveProgramID, "Samples");
+	CurveColorID = glGetUniformLocation(curveProgramID, "CurveColor");
+
+	// both sets have the same layout, so the VAOs are made from the first
+	CurveSet& s = curveSets[0];
+	sizeObjects(s, Vertices.count);
+	createVAOs(Vertices, 0);
 	// Subdivision VAOs
-	createVAOs(subdivision1, level1, sizeof(subdivision1), sizeof(level1), 1);
-	createVAOs(subdivision2, level2, sizeof(subdivision2), sizeof(level2), 2);
-	createVAOs(subdivision3, level3, sizeof(subdivision3), sizeof(level3), 3);
-	createVAOs(subdivision4, level4, sizeof(subdivision4), sizeof(level4), 4);
-	createVAOs(subdivision5, level5, sizeof(subdivision5), sizeof(level5), 5);
+	for (int level = 1; level <= MaxLevel; level++) {
+		createVAOs(s.subdivision[level], level);
+	}
 	// Bezier Curves VAO
-	createVAOs(beziercurve, bezierIndices, sizeof(beziercurve), sizeof(bezierIndices), 6);
+	createVAOs(s.beziercurve, 6);
 	// Catmull-Rom Curves VAOs
-	createVAOs(catmullrom, catmullromIndices, sizeof(catmullrom), sizeof(catmullromIndices), 7);
-	createVAOs(decastel, decastelIndices, sizeof(decastel), sizeof(decastelIndices), 8);
+	createVAOs(s.catmullromXY, 7);
+	createVAOs(s.decastel, 8);
 	// Looping vertex VAO
-	createVAOs(dotloop, dotloopIndex, sizeof(dotloop), sizeof(dotloopIndex), 9);
+	createVAOs(s.dotloop, 9);
+
+	createPickBuffer();
+
+	// GPU curves read the control point VBO in place, as RGBA32F texels
+	glGenTextures(1, &ControlPointsTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, ControlPointsTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, VertexBufferId[0]);
+	// and which curve each is on, two ints per point
+	glGenBuffers(1, &CurveRangesBufferId);
+	glBindBuffer(GL_TEXTURE_BUFFER, CurveRangesBufferId);
+	glBufferData(GL_TEXTURE_BUFFER, 0, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, &CurveRangesTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, CurveRangesTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, CurveRangesBufferId);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	// core profile still wants a VAO bound, even with no attributes
+	glGenVertexArrays(1, &CurveVertexArrayId);
+
+	// direct subdivision streams every chunk through the same buffer
+	directChunk.resize(DirectChunk + 1);
+	glGenVertexArrays(1, &DirectVertexArrayId);
+	glBindVertexArray(DirectVertexArrayId);
+	glGenBuffers(1, &DirectBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, DirectBufferId);
+	glBufferData(GL_ARRAY_BUFFER, (DirectChunk + 1) * sizeof(CurveVertex), NULL, GL_STREAM_DRAW);
+	vertexFormat(directChunk.data);
+	glBindVertexArray(0);
 
+	// every curve of an object in one call, and every view too where the GL can
+	multiDrawIndirect = GLEW_ARB_multi_draw_indirect != 0;
+	glGenBuffers(1, &IndirectBufferId);
+
+	// pick the curve kernels before any worker can race to do it
+	GetSimdLevel();
+	WorkersInit(0);
+	// the first call only fills the pipeline, the second brings that set to the front
+	createObjects();
 	createObjects();
 
+	ProfileInit(TraceFrames);
+
 	// ATTN: create VAOs for each of the newly created objects here:
 	// createVAOs(<fill this appropriately>);
 
 }
 
-void createVAOs(Vertex Vertices[], unsigned short Indices[], size_t BufferSize, size_t IdxBufferSize, int ObjectId) {
+// offscreen ID buffer for GPU picking, and the pixel buffer its reads go through
+void createPickBuffer(void)
+{
+	glGenRenderbuffers(1, &PickColorBufferId);
+	glBindRenderbuffer(GL_RENDERBUFFER, PickColorBufferId);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, window_width, window_height);
+	glGenRenderbuffers(1, &PickDepthBufferId);
+	glBindRenderbuffer(GL_RENDERBUFFER, PickDepthBufferId);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &PickFramebufferId);
+	glBindFramebuffer(GL_FRAMEBUFFER, PickFramebufferId);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, PickColorBufferId);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, PickDepthBufferId);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "ERROR: Could not create the picking framebuffer\n");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// big enough for the largest neighbourhood
+	glGenBuffers(1, &PickPixelBufferId);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, PickPixelBufferId);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (2 * MaxPickNeighbourhood + 1) * (2 * MaxPickNeighbourhood + 1) * sizeof(GLuint), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Objects are drawn straight from their vertex buffer, vertices in order, unless
+// they are created with indices, which is only worth it when primitives share vertices.
+// T is the vertex layout, Vertex or CurveVertex, see vertexFormat().
+template <typename T>
+void createVAOs(GrowBuffer<T>& Vertices, int ObjectId) {
 
-	NumVert[ObjectId] = IdxBufferSize / (sizeof GLubyte);
+	NumVert[ObjectId] = Vertices.count;
+	// allocate the GL buffer at the object's full capacity so it keeps up with the CPU side
+	VBOCapacity[ObjectId] = Vertices.capacity;
 
 	GLenum ErrorCheckValue = glGetError();
-	size_t VertexSize = sizeof(Vertices[0]);
-	size_t RgbOffset = sizeof(Vertices[0].XYZW);
 
 	// Create Vertex Array Object
 	glGenVertexArrays(1, &VertexArrayId[ObjectId]);
@@ -873,19 +1892,11 @@ void createVAOs(Vertex Vertices[], unsigned short Indices[], size_t BufferSize,
 	// Create Buffer for vertex data
 	glGenBuffers(1, &VertexBufferId[ObjectId]);
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[ObjectId]);
-	glBufferData(GL_ARRAY_BUFFER, BufferSize, Vertices, GL_STATIC_DRAW);
-
-	// Create Buffer for indices
-	glGenBuffers(1, &IndexBufferId[ObjectId]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBufferId[ObjectId]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, IdxBufferSize, Indices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, VBOCapacity[ObjectId] * sizeof(T), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, Vertices.bytes(), Vertices.data);
 
 	// Assign vertex attributes
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, VertexSize, 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid*)RgbOffset);
-
-	glEnableVertexAttribArray(0);	// position
-	glEnableVertexAttribArray(1);	// color
+	vertexFormat(Vertices.data);
 
 	// Disable our Vertex Buffer Object 
 	glBindVertexArray(0);
@@ -901,38 +1912,377 @@ void createVAOs(Vertex Vertices[], unsigned short Indices[], size_t BufferSize,
 	}
 }
 
+// same, with an element buffer drawn through Indices
+void createVAOs(GrowBuffer<Vertex>& Vertices, GrowBuffer<GLuint>& Indices, int ObjectId) {
+
+	createVAOs(Vertices, ObjectId);
+	NumVert[ObjectId] = Indices.count;
+	IBOCapacity[ObjectId] = Indices.capacity;
+
+	// Create Buffer for indices
+	glBindVertexArray(VertexArrayId[ObjectId]);
+	glGenBuffers(1, &IndexBufferId[ObjectId]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBufferId[ObjectId]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, IBOCapacity[ObjectId] * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, Indices.bytes(), Indices.data);
+	glBindVertexArray(0);
+}
+
+// send the vertices marked with markObjectDirty() since the last upload
+template <typename T>
+static void uploadVertices(int ObjectId, GrowBuffer<T>& Vertices)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[ObjectId]);
+	if (Vertices.count > VBOCapacity[ObjectId]) {
+		VBOCapacity[ObjectId] = Vertices.capacity;
+		markObjectDirty(ObjectId, 0, Vertices.count);
+	}
+	size_t first = DirtyBegin[ObjectId];
+	size_t last = DirtyEnd[ObjectId] < Vertices.count ? DirtyEnd[ObjectId] : Vertices.count;
+	if (first < last) {
+		if (first == 0 && last == Vertices.count) {
+			// whole object: orphan the old storage so the driver never waits for draws still reading it
+			glBufferData(GL_ARRAY_BUFFER, VBOCapacity[ObjectId] * sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(T), (last - first) * sizeof(T), Vertices.data + first);
+		frameUploadBytes += (last - first) * sizeof(T);
+		frameUploads++;
+	}
+	DirtyBegin[ObjectId] = DirtyEnd[ObjectId] = 0;
+}
+
+// Upload an object's vertices into its VBO. The VAO of ObjectId must be bound.
+// GL buffers are only re-created when the object has outgrown them.
+// Only the vertices marked with markObjectDirty() since the last upload are sent.
+template <typename T>
+void uploadObject(int ObjectId, GrowBuffer<T>& Vertices)
+{
+	ProfileScope profile(PhaseUpload);
+	uploadVertices(ObjectId, Vertices);
+	NumVert[ObjectId] = Vertices.count;
+}
+
+// same, for an object created with indices
+void uploadObject(int ObjectId, GrowBuffer<Vertex>& Vertices, GrowBuffer<GLuint>& Indices)
+{
+	ProfileScope profile(PhaseUpload);
+	uploadVertices(ObjectId, Vertices);
+
+	// indices only change when the object changes size
+	if (Indices.count != NumVert[ObjectId]) {
+		if (Indices.count > IBOCapacity[ObjectId]) {
+			IBOCapacity[ObjectId] = Indices.capacity;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, IBOCapacity[ObjectId] * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+		}
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, Indices.bytes(), Indices.data);
+		NumVert[ObjectId] = Indices.count;
+		frameUploadBytes += Indices.bytes();
+		frameUploads++;
+	}
+}
+
+// vertices [begin, end) of ObjectId changed and must go up with its next upload
+void markObjectDirty(int ObjectId, size_t begin, size_t end)
+{
+	if (ObjectId == 0) {
+		// the ID buffer shows the control points too
+		idBufferDirty = true;
+	}
+	if (DirtyBegin[ObjectId] == DirtyEnd[ObjectId]) {
+		DirtyBegin[ObjectId] = begin;
+		DirtyEnd[ObjectId] = end;
+		return;
+	}
+	if (begin < DirtyBegin[ObjectId]) {
+		DirtyBegin[ObjectId] = begin;
+	}
+	if (end > DirtyEnd[ObjectId]) {
+		DirtyEnd[ObjectId] = end;
+	}
+}
+
 void cleanup(void)
 {
 	// Cleanup VBO and shader
-	for (int i = 0; i < NumObjects; i++) {
+	for (GLuint i = 0; i < NumObjects; i++) {
 		glDeleteBuffers(1, &VertexBufferId[i]);
-		glDeleteBuffers(1, &IndexBufferId[i]);
+		if (IndexBufferId[i]) {
+			glDeleteBuffers(1, &IndexBufferId[i]);
+		}
 		glDeleteVertexArrays(1, &VertexArrayId[i]);
 	}
-	glDeleteProgram(programID);
+	glDeleteBuffers(1, &ViewsBufferId);
+	glDeleteTextures(1, &ControlPointsTexture);
+	glDeleteTextures(1, &CurveRangesTexture);
+	glDeleteBuffers(1, &CurveRangesBufferId);
+	glDeleteBuffers(1, &IndirectBufferId);
+	glDeleteFramebuffers(1, &PickFramebufferId);
+	glDeleteRenderbuffers(1, &PickColorBufferId);
+	glDeleteRenderbuffers(1, &PickDepthBufferId);
+	glDeleteBuffers(1, &PickPixelBufferId);
+	if (pickFence) {
+		glDeleteSync(pickFence);
+	}
+	glDeleteVertexArrays(1, &CurveVertexArrayId);
+	glDeleteVertexArrays(1, &DirectVertexArrayId);
+	glDeleteBuffers(1, &DirectBufferId);
+	for (int variant = 0; variant < NumShadeVariants; variant++) {
+		glDeleteProgram(shadePrograms[variant].id);
+	}
 	glDeleteProgram(pickingProgramID);
+	glDeleteProgram(curveProgramID);
+	ProfileTerminate();
+	WorkersTerminate();
+	SceneClose();
+	InputRecordClose();
+	InputReplayClose();
+	PoolTrim();
 
 	// Close OpenGL window and terminate GLFW
-	glfwTerminate();
+	if (headless) {
+		HeadlessTerminate();
+	}
+	else {
+		glfwTerminate();
+	}
+}
+
+// log an event, with the cursor where it is now, if the session is being recorded
+void recordInput(int type, int code, int action)
+{
+	if (!replaying) {
+		double xpos, ypos;
+		cursorPos(&xpos, &ypos);
+		InputRecord(type, code, action, xpos, ypos);
+	}
 }
 
-static void mouseCallback(GLFWwindow* window, int button, int action, int mods)
+static void mouseCallback(GLFWwindow*, int button, int action, int)
 {
+	recordInput(InputMouseButton, button, action);
+	stampInput();
+	damage();
+	// before picking, which only starts a drag while the button is down
+	if (button == GLFW_MOUSE_BUTTON_LEFT) {
+		leftButton = action != GLFW_RELEASE;
+	}
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
 		pickVertex();
 	}
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
-		if (isChanged && gPickedIndex < IndexCount) {
+		if (isChanged && gPickedIndex < Vertices.count) {
 			Vertices[gPickedIndex].RGBA[0] = pickedR;
 			Vertices[gPickedIndex].RGBA[1] = pickedG;
 			Vertices[gPickedIndex].RGBA[2] = pickedB;
+			markObjectDirty(0, gPickedIndex, gPickedIndex + 1);
 			isChanged = false;
 		}
 	}
 }
 
-static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+// the window was uncovered, or has to be drawn again for some other reason
+static void refreshCallback(GLFWwindow*)
+{
+	damage();
+}
+
+// only the last position counts; only a move that drags a point is timed
+static void cursorCallback(GLFWwindow*, double xpos, double ypos)
+{
+	cursor[0] = xpos;
+	cursor[1] = ypos;
+	cursorMoved = true;
+	if (isChanged) {
+		stampInput();
+	}
+}
+
+static void resizeCallback(GLFWwindow*, int width, int height)
+{
+	viewport[2] = width;
+	viewport[3] = height;
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	TwWindowSize(width, height);
+	damage();
+}
+
+// INPUT RECORDING
+// hw1b --record file logs the session, hw1b --bench --replay file plays it back
+
+void cursorPos(double* xpos, double* ypos)
+{
+	*xpos = cursor[0];
+	*ypos = cursor[1];
+}
+
+bool leftButtonDown(void)
+{
+	return leftButton;
+}
+
+// feed the recorded events of a frame back through the callbacks, in the order
+// they happened; called where the main loop handles its input
+void replayInput(int frame)
+{
+	const InputEvent* e;
+	while ((e = InputReplayEvent(frame)) != NULL) {
+		if (e->type == InputCursor) {
+			cursorCallback(window, e->x, e->y);
+			continue;
+		}
+		cursor[0] = e->x;
+		cursor[1] = e->y;
+		if (e->type == InputMouseButton) {
+			mouseCallback(window, e->code, e->action, 0);
+		}
+		else if (e->type == InputKey) {
+			keyCallback(window, e->code, 0, e->action, 0);
+		}
+	}
+}
+
+void setGpuCurves(bool on)
+{
+	if (gpuCurves == on) {
+		return;
+	}
+	// the sets drop their CPU curves when they are next built, see startCurveBuild()
+	gpuCurves = on;
+}
+
+// SCENE FILES
+// the control points come straight from the mapped file, see scene.hpp
+
+// what is drawn now, for saving
+SceneView currentView(void)
+{
+	SceneView view;
+	view.pressed = pressed;
+	view.count = count;
+	view.loop = loop;
+	view.splitView = splitView;
+	view.quadView = quadView;
+	view.gpuCurves = gpuCurves;
+	view.directSubdivision = directSubdivision;
+	view.directLevel = directLevel;
+	view.directLimit = directLimit;
+	view.curveSamples = curveSamples;
+	view.curveTolerance = curveTolerance;
+	view.loopSpeed = loopSpeed;
+	return view;
+}
+
+// make path the control polygon, before initOpenGL(); only its first chunk of
+// points is in when this returns, the rest arrive through streamScene()
+bool loadScene(const char* path)
+{
+	SceneView view = currentView();
+	std::vector<SceneCurve> fileCurves;
+	std::vector<SceneObject> objects;
+	if (!SceneOpen(path, &view, &fileCurves, &objects)) {
+		return false;
+	}
+	// the file is not trusted: keep each setting in the range the GUI allows,
+	// count indexes the per-level arrays and directLevel is a shift count
+	pressed = std::min(std::max(view.pressed, 0), 3);
+	count = std::min(std::max(view.count, 0), MaxLevel);
+	loop = view.loop != 0;
+	splitView = view.splitView != 0;
+	quadView = view.quadView != 0;
+	setGpuCurves(view.gpuCurves != 0);
+	directSubdivision = view.directSubdivision != 0;
+	directLevel = std::min(std::max(view.directLevel, 1), 24);
+	directLimit = view.directLimit != 0;
+	curveSamples = std::min(std::max(view.curveSamples, 1), 1024);
+	// written so that NaN fails the test too
+	curveTolerance = view.curveTolerance >= 0.05f && view.curveTolerance <= 16.0f ? view.curveTolerance : 0.25f;
+	loopSpeed = view.loopSpeed >= 0.0f && view.loopSpeed <= 20.0f ? view.loopSpeed : 1.0f;
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (objects[i].id < NumObjects && ObjectColor[objects[i].id] != NULL) {
+			memcpy(ObjectColor[objects[i].id], objects[i].rgba, sizeof(objects[i].rgba));
+		}
+	}
+
+	// the buffers are sized for the whole file, but only what is in is drawn
+	size_t n;
+	Vertex* points = ScenePoints(&n);
+	setCurves(fileCurves, n);
+	Vertices.borrow(points, n);
+	Vertices.count = SceneLoadedPoints();
+	sceneStreaming = Vertices.count < n;
+	scenePath = path;
+	return true;
+}
+
+// Make table the object table for n control points. The curves must cover the
+// points in order, each with at least MinCurvePoints; otherwise it is one curve
+// of them all, as an empty table is.
+void setCurves(const std::vector<SceneCurve>& table, size_t n)
+{
+	size_t next = 0;
+	for (size_t c = 0; c < table.size(); c++) {
+		if (table[c].first != next || table[c].count < MinCurvePoints) {
+			break;
+		}
+		next += table[c].count;
+	}
+	curves.clear();
+	if (next == n) {
+		curves = table;
+	}
+	else if (!table.empty()) {
+		fprintf(stderr, "WARNING: the curves do not cover the %u control points, they are drawn as one\n", (unsigned int)n);
+	}
+	curvesVersion++;
+}
+
+// draw the points read in since the last frame
+void streamScene(void)
 {
+	if (!sceneStreaming) {
+		return;
+	}
+	size_t n;
+	ScenePoints(&n);
+	size_t loaded = SceneLoadedPoints();
+	if (loaded != Vertices.count) {
+		damage();
+	}
+	Vertices.count = loaded;
+	if (Vertices.count == n) {
+		sceneStreaming = false;
+	}
+}
+
+// write the scene to path; *written, if not NULL, gets the control points saved
+bool saveScene(const char* path, size_t* written)
+{
+	SceneObject objects[NumObjects - 1];
+	for (GLuint id = 1; id < NumObjects; id++) {
+		objects[id - 1].id = id;
+		memcpy(objects[id - 1].rgba, ObjectColor[id], sizeof(objects[id - 1].rgba));
+	}
+	// a file still being read in is saved whole; its points are read here instead
+	size_t n = Vertices.count;
+	if (sceneStreaming) {
+		ScenePoints(&n);
+	}
+	std::vector<SceneCurve> table = curves;
+	if (table.empty()) {
+		SceneCurve all = { 0, (uint32_t)n };
+		table.push_back(all);
+	}
+	if (written != NULL) {
+		*written = n;
+	}
+	return SceneSave(path, Vertices.data, n, &table[0], table.size(), objects, NumObjects - 1, currentView());
+}
+
+static void keyCallback(GLFWwindow*, int key, int, int action, int)
+{
+	recordInput(InputKey, key, action);
+	stampInput();
+	damage();
 	if (key == GLFW_KEY_1 && action == GLFW_RELEASE) {
 		pressed = 1;
 		count++;		
@@ -951,85 +2301,474 @@ static void keyCallback(GLFWwindow* window, int key, int scancode, int action, i
 	if (key == GLFW_KEY_5 && action == GLFW_PRESS) {
 		loop = !loop;
 	}
+	if (key == GLFW_KEY_6 && action == GLFW_PRESS) {
+		quadView = !quadView;
+	}
+	if (key == GLFW_KEY_7 && action == GLFW_PRESS) {
+		setGpuCurves(!gpuCurves);
+	}
+	if (key == GLFW_KEY_8 && action == GLFW_PRESS) {
+		cpuPicking = !cpuPicking;
+	}
+	if (key == GLFW_KEY_9 && action == GLFW_PRESS) {
+		directSubdivision = !directSubdivision;
+	}
+	if (key == GLFW_KEY_0 && action == GLFW_PRESS) {
+		onDemand = !onDemand;
+	}
+	if (key == GLFW_KEY_S && action == GLFW_PRESS) {
+		size_t written;
+		if (saveScene(scenePath, &written)) {
+			printf("wrote %u control points to %s\n", (unsigned int)written, scenePath);
+		}
+	}
+	if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		if (ProfileWriteTrace("hw1b_trace.json")) {
+			printf("wrote the last %d frames to hw1b_trace.json\n", TraceFrames);
+		}
+	}
 	if ((key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT) && action == GLFW_PRESS) {
 		zPick = !zPick;
 	}
 }
 
-int main(void)
+// BENCHMARK MODE
+// hw1b --bench [--frames N] [--points N [--curves N] | --scene file] [--save file] [--replay file] [--out file.json] [--trace trace.json]
+// Runs a scripted scene offscreen for a fixed number of frames, with no vsync,
+// and writes frame time percentiles and a per-phase breakdown as JSON. With
+// --replay, a session recorded with --record is played back instead, one
+// recorded frame per frame; give it the --scene the session started from.
+
+// one step of the scripted scene; each runs for an equal share of the frames
+struct BenchStep {
+	const char* name;
+	int pressed;
+	int count;
+	bool loop;
+	bool splitView;
+	bool quadView;
+	bool gpuCurves;
+	int directLevel; // 0 keeps the stored levels
+};
+const BenchStep benchSteps[] = {
+	{ "control polygon", 0, 0, false, false, false, false, 0 },
+	{ "subdivision 1", 1, 1, false, false, false, false, 0 },
+	{ "subdivision 5", 1, 5, false, false, false, false, 0 },
+	{ "direct subdivision 12", 1, 0, false, false, false, false, 12 },
+	{ "bezier", 2, 0, false, false, false, false, 0 },
+	{ "catmull-rom", 3, 0, false, false, false, false, 0 },
+	{ "catmull-rom loop", 3, 0, true, false, false, false, 0 },
+	{ "split view", 3, 0, true, true, false, false, 0 },
+	{ "quad view", 3, 0, true, false, true, false, 0 },
+	{ "gpu curves", 3, 0, true, false, true, true, 0 },
+};
+const int NumBenchSteps = sizeof(benchSteps) / sizeof(BenchStep);
+const int BenchWarmup = 5; // frames at the start of each step left out of the statistics
+
+// phases with GPU timers
+const ProfilePhase benchGPUPhases[] = { PhaseDraw, PhaseGUI };
+const int NumBenchGPUPhases = sizeof(benchGPUPhases) / sizeof(ProfilePhase);
+
+double benchNow(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// nearest-rank percentile of sorted times
+double percentile(const std::vector<double>& sorted, double p)
 {
-	// initialize window
-	int errorCode = initWindow();
+	size_t rank = (size_t)ceil(p * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// "name": { mean, p50, p95, p99, max } of times in ms
+void writeStats(FILE* out, const char* name, std::vector<double> times, const char* indent)
+{
+	std::sort(times.begin(), times.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < times.size(); i++) {
+		sum += times[i];
+	}
+	fprintf(out, "%s\"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+		indent, name, sum / times.size(), percentile(times, 0.50), percentile(times, 0.95), percentile(times, 0.99), times.back());
+}
+
+// n points in numCurves closed polygons, each on a wobbly circle, laid out in a
+// grid that fits the front view; one curve is as big as the view allows
+void makeBenchPolygon(int n, int numCurves)
+{
+	float color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	if (numCurves < 1) {
+		numCurves = 1;
+	}
+	int perCurve = n / numCurves > MinCurvePoints ? n / numCurves : MinCurvePoints;
+	int cols = (int)ceil(sqrt((double)numCurves));
+	int rows = (numCurves + cols - 1) / cols;
+	float cellWidth = 8.0f / cols, cellHeight = 6.0f / rows;
+	float scale = std::min(1.0f, std::min(cellWidth, cellHeight) / 4.0f);
+	Vertices.resize(perCurve * numCurves);
+	std::vector<SceneCurve> table(numCurves);
+	for (int c = 0; c < numCurves; c++) {
+		float cx = ((c % cols) + 0.5f - 0.5f * cols) * cellWidth;
+		float cy = ((c / cols) + 0.5f - 0.5f * rows) * cellHeight;
+		table[c].first = c * perCurve;
+		table[c].count = perCurve;
+		for (int i = 0; i < perCurve; i++) {
+			float a = 2.0f * float(PI) * i / perCurve;
+			float r = scale * (1.5f + 0.25f * sinf(7.0f * a));
+			float coords[] = { cx + r * cosf(a), cy + r * sinf(a), 0.0f, 1.0f };
+			Vertices[c * perCurve + i].SetCoords(coords);
+			Vertices[c * perCurve + i].SetColor(color);
+		}
+	}
+	setCurves(table, Vertices.count);
+}
+
+int runBenchmark(int frames, int points, int numCurves, const char* scene, const char* savePath, const char* replay, const char* outPath, const char* tracePath)
+{
+	int errorCode = initHeadless();
 	if (errorCode != 0)
 		return errorCode;
 
-	// initialize each subdivision level's index count
-	subIndexCount.resize(6);  // max 5 levels then reset
-	for (int i = 0; i < 6; i++) {
-		if (i == 0) {
-			subIndexCount.at(0) = (MC); // base is original index count
-		}
-		else {
-			subIndexCount.at(i) = (2 * subIndexCount.at(i - 1)); // each subdivision doubles the count
+	// a recording runs for as long as it was recorded, in place of the script
+	if (replay) {
+		if (!InputReplayOpen(replay)) {
+			HeadlessTerminate();
+			return -1;
 		}
+		frames = InputReplayFrames();
+		replaying = true;
 	}
 
-	// initialize indices for each subdivision level
-	for (int i = 0; i < 20; i++) {
-		level1[i] = i;
+	if (scene) {
+		if (!loadScene(scene)) {
+			HeadlessTerminate();
+			return -1;
+		}
+	}
+	else if (points > 0) {
+		makeBenchPolygon(points, numCurves);
 	}
-	for (int i = 0; i < 40; i++) {
-		level2[i] = i;
+	else {
+		Vertices.resize(sizeof(initialVertices) / sizeof(Vertex));
+		memcpy(Vertices.data, initialVertices, sizeof(initialVertices));
 	}
-	for (int i = 0; i < 80; i++) {
-		level3[i] = i;
+	// the scene as it starts, so a large one can be made once and loaded after
+	if (savePath && !saveScene(savePath, NULL)) {
+		HeadlessTerminate();
+		return -1;
 	}
-	for (int i = 0; i < 160; i++) {
-		level4[i] = i;
+	initOpenGL();
+
+	// the dragged point circles around where it started
+	GLuint dragged = 0;
+	float dragX = Vertices[dragged].XYZW[0];
+	float dragY = Vertices[dragged].XYZW[1];
+
+	std::vector<double> frameTimes;
+	std::vector<double> phaseTimes[NumProfilePhases];
+	std::vector<double> gpuTimes[NumBenchGPUPhases];
+	long gpuFrame = -1;
+	int measureFrom = 0; // first frame counted in gpuTimes, as those arrive late
+	std::vector<double> stepTimes[NumBenchSteps];
+	unsigned int maxDrawCalls = 0; // in any one measured frame
+	std::vector<double> latencies; // of the replayed input, see frameSwapped()
+	std::vector<double> pickLatencies;
+	unsigned int picksSeen = picksResolved;
+	int step = -1;
+	int stepStart = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		int s = replaying ? 0 : frame * NumBenchSteps / frames;
+		if (s != step && !replaying) {
+			step = s;
+			stepStart = frame;
+			pressed = benchSteps[s].pressed;
+			count = benchSteps[s].count;
+			loop = benchSteps[s].loop;
+			splitView = benchSteps[s].splitView;
+			quadView = benchSteps[s].quadView;
+			setGpuCurves(benchSteps[s].gpuCurves);
+			directSubdivision = benchSteps[s].directLevel > 0;
+			if (directSubdivision) {
+				directLevel = benchSteps[s].directLevel;
+			}
+		}
+
+		double start = benchNow();
+		ProfileBeginFrame();
+		// GPU times come back a few frames late, and only count once past the warmup
+		if (ProfileGPUFrame() != gpuFrame) {
+			gpuFrame = ProfileGPUFrame();
+			if (gpuFrame >= measureFrom) {
+				for (int i = 0; i < NumBenchGPUPhases; i++) {
+					gpuTimes[i].push_back(ProfileFrameGPU(benchGPUPhases[i]));
+				}
+			}
+		}
+		ProfileBegin(PhaseInput, false);
+		if (replaying) {
+			// the recorded session, handled as the main loop handles it
+			replayInput(frame);
+			handleInput();
+		}
+		else {
+			streamScene();
+			// scripted input: drag one control point around a small circle
+			stampInput();
+			moveVertexTo(dragged, dragX + 0.2f * cosf(0.1f * frame), dragY + 0.2f * sinf(0.1f * frame));
+		}
+		inputHandled();
+		ProfileEnd();
+		ProfileBegin(PhaseCreateObjects, false);
+		createObjects();
+		ProfileEnd();
+		drawScene();
+		ProfileBegin(PhaseSwap, false);
+		swapBuffers();
+		// a pbuffer swap does not wait for rendering, so make the frame include it
+		glFinish();
+		ProfileEnd();
+		ProfileEndFrame();
+		double latency = frameSwapped();
+		double frameTime = 1000.0 * (benchNow() - start);
+		unsigned int drawCalls = frameDrawCalls;
+		frameDrawCalls = 0;
+		// picks are few, so those in warm-up frames count too
+		if (picksResolved != picksSeen) {
+			picksSeen = picksResolved;
+			pickLatencies.push_back(pickLatency);
+		}
+
+		if (frame - stepStart < BenchWarmup) {
+			measureFrom = frame + 1;
+			continue;
+		}
+		frameTimes.push_back(frameTime);
+		stepTimes[s].push_back(frameTime);
+		if (drawCalls > maxDrawCalls) {
+			maxDrawCalls = drawCalls;
+		}
+		if (latency >= 0.0) {
+			latencies.push_back(latency);
+		}
+		for (int p = 0; p < NumProfilePhases; p++) {
+			phaseTimes[p].push_back(ProfileFrameCPU((ProfilePhase)p));
+		}
 	}
-	for (int i = 0; i < 320; i++) {
-		level5[i] = i;
+	if (tracePath) {
+		if (!ProfileWriteTrace(tracePath)) {
+			fprintf(stderr, "ERROR: Could not open %s\n", tracePath);
+		}
 	}
 
-	// initialize bezier indices
-	for (int i = 0; i < 40; i++) {
-		bezierIndices[i] = i;
+	FILE* out = stdout;
+	if (outPath) {
+		out = fopen(outPath, "w");
+		if (out == NULL) {
+			fprintf(stderr, "ERROR: Could not open %s\n", outPath);
+			cleanup();
+			return -1;
+		}
+	}
+	if (frameTimes.empty()) {
+		fprintf(stderr, "ERROR: %d frames is too few to measure anything\n", frames);
+	}
+	else {
+		fprintf(out, "{\n");
+		fprintf(out, "  \"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+		fprintf(out, "  \"curve_kernels\": \"%s\",\n", SimdLevelName(GetSimdLevel()));
+		fprintf(out, "  \"points\": %u,\n", (unsigned int)Vertices.count);
+		// adaptive tessellation against the fixed CRSamples per segment, as last drawn on the CPU
+		fprintf(out, "  \"curve_vertices\": %u,\n", curveVertices);
+		fprintf(out, "  \"uniform_curve_vertices\": %u,\n", (unsigned int)(CRSamples * Vertices.count));
+		// with multi-draw this stays the same however many curves there are
+		fprintf(out, "  \"curves\": %u,\n", (unsigned int)front->curves.size());
+		fprintf(out, "  \"multi_draw\": \"%s\",\n", multiDrawIndirect ? "indirect" : "per view");
+		fprintf(out, "  \"draw_calls_max\": %u,\n", maxDrawCalls);
+		fprintf(out, "  \"input\": \"%s\",\n", replaying ? "replay" : "scripted");
+		fprintf(out, "  \"frames\": %u,\n", (unsigned int)frameTimes.size());
+		writeStats(out, "frame_ms", frameTimes, "  ");
+		if (!latencies.empty()) {
+			// from a replayed event until the frame that shows it is finished
+			fprintf(out, ",\n");
+			writeStats(out, "input_latency_ms", latencies, "  ");
+		}
+		if (!pickLatencies.empty()) {
+			// from a click until its pick is resolved
+			fprintf(out, ",\n");
+			writeStats(out, "pick_latency_ms", pickLatencies, "  ");
+		}
+		fprintf(out, ",\n  \"phases_ms\": {\n");
+		for (int p = 0; p < NumProfilePhases; p++) {
+			writeStats(out, ProfilePhaseNames[p], phaseTimes[p], "    ");
+			fprintf(out, p + 1 < NumProfilePhases ? ",\n" : "\n");
+		}
+		if (!gpuTimes[0].empty()) {
+			fprintf(out, "  },\n  \"gpu_phases_ms\": {\n");
+			for (int i = 0; i < NumBenchGPUPhases; i++) {
+				writeStats(out, ProfilePhaseNames[benchGPUPhases[i]], gpuTimes[i], "    ");
+				fprintf(out, i + 1 < NumBenchGPUPhases ? ",\n" : "\n");
+			}
+		}
+		fprintf(out, "  },\n  \"steps_ms\": {\n");
+		bool first = true;
+		for (int i = 0; i < NumBenchSteps; i++) {
+			if (stepTimes[i].empty()) {
+				continue;
+			}
+			fprintf(out, first ? "" : ",\n");
+			writeStats(out, replaying ? "replay" : benchSteps[i].name, stepTimes[i], "    ");
+			first = false;
+		}
+		fprintf(out, "\n  }\n}\n");
 	}
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	cleanup();
+	return frameTimes.empty() ? -1 : 0;
+}
 
-	// initialize catmullrom indices
-	for (int i = 0; i < 40; i++) {
-		catmullromIndices[i] = i;
+int main(int argc, char** argv)
+{
+	// benchmark mode
+	bool bench = false;
+	int benchFrames = 900;
+	int benchPoints = 0;
+	int benchCurves = 1;
+	const char* benchOut = NULL;
+	const char* benchTrace = NULL;
+	const char* scene = NULL;
+	const char* savePath = NULL;
+	const char* replay = NULL;
+	const char* record = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench") == 0) {
+			bench = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			benchFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+			benchPoints = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--curves") == 0 && i + 1 < argc) {
+			benchCurves = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			benchOut = argv[++i];
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			benchTrace = argv[++i];
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+			scene = argv[++i];
+		}
+		else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+			savePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replay = argv[++i];
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record = argv[++i];
+		}
+		else if (strcmp(argv[i], "--continuous") == 0) {
+			onDemand = false;
+		}
+		else {
+			fprintf(stderr, "usage: %s [--scene file] [--record file] [--continuous] [--bench [--frames N] [--points N [--curves N]] [--save file] [--replay file] [--out file.json] [--trace trace.json]]\n", argv[0]);
+			return -1;
+		}
 	}
+	if (bench) {
+		return runBenchmark(benchFrames, benchPoints, benchCurves, scene, savePath, replay, benchOut, benchTrace);
+	}
+
+	// initialize window
+	int errorCode = initWindow();
+	if (errorCode != 0)
+		return errorCode;
 
-	// initialize decasteljau indices
-	for (int i = 0; i < 150; i++) {
-		decastelIndices[i] = i;
+	// initialize the control polygon
+	if (scene) {
+		if (!loadScene(scene)) {
+			glfwTerminate();
+			return -1;
+		}
+	}
+	else {
+		Vertices.resize(sizeof(initialVertices) / sizeof(Vertex));
+		memcpy(Vertices.data, initialVertices, sizeof(initialVertices));
 	}
 
 	// initialize OpenGL pipeline
 	initOpenGL();
+	printf("curve kernels: %s\n", SimdLevelName(GetSimdLevel()));
+	if (record && !InputRecordOpen(record)) {
+		cleanup();
+		return -1;
+	}
 
 	// For speed computation
 	double lastTime = glfwGetTime();
 	int nbFrames = 0;
+	size_t secondUploadBytes = 0;
+	size_t secondUploads = 0;
+	size_t secondDrawCalls = 0;
+	double secondLatency = 0.0; // ms, the worst input latency this second
 	do {
+		waitForDamage();
+
 		// Measure speed
 		double currentTime = glfwGetTime();
 		nbFrames++;
+		secondUploadBytes += frameUploadBytes;
+		secondUploads += frameUploads;
+		secondDrawCalls += frameDrawCalls;
+		frameUploadBytes = 0;
+		frameUploads = 0;
+		frameDrawCalls = 0;
 		if (currentTime - lastTime >= 1.0){ // If last prinf() was more than 1sec ago
 			// printf and reset
-			printf("%f ms/frame\n", 1000.0 / double(nbFrames));
+			uploadBytesPerFrame = secondUploadBytes / nbFrames;
+			uploadsPerFrame = secondUploads / nbFrames;
+			drawCallsPerFrame = secondDrawCalls / nbFrames;
+			printf("%f ms/frame, %u bytes uploaded/frame, %u draw calls/frame, last pick %.3f ms, input latency up to %.3f ms\n", 1000.0 / double(nbFrames), uploadBytesPerFrame, drawCallsPerFrame, pickLatency, secondLatency);
 			nbFrames = 0;
+			secondUploadBytes = 0;
+			secondUploads = 0;
+			secondDrawCalls = 0;
+			secondLatency = 0.0;
 			lastTime += 1.0;
+			// after a sleep, the next second starts now
+			if (currentTime - lastTime >= 1.0) {
+				lastTime = currentTime;
+			}
 		}
 
-		// DRAGGING: move current (picked) vertex with cursor
-		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT))
-			moveVertex();
+		ProfileBeginFrame();
+		ProfileBegin(PhaseInput, false);
+		handleInput();
+		inputHandled();
+		ProfileEnd();
 
 		// DRAWING SCENE
+		ProfileBegin(PhaseCreateObjects, false);
 		createObjects();	// re-evaluate curves in case vertices have been moved
+		ProfileEnd();
 		drawScene();
+		if (damagedFrames > 0) {
+			damagedFrames--;
+		}
+		// what the swap delivers is handled in the next frame
+		InputRecordFrame();
+		ProfileBegin(PhaseSwap, false);
+		swapBuffers();
+		ProfileEnd();
+		ProfileEndFrame();
+		secondLatency = std::max(secondLatency, frameSwapped());
 
 	} // Check if the ESC key was pressed or the window was closed
 	while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
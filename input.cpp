@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "input.hpp"
+
+static const char InputMagic[8] = "HW1BINP";
+
+// recording
+static FILE* recordFile = NULL;
+static std::chrono::steady_clock::time_point recordStart;
+static uint32_t recordFrame = 0;
+static float lastX = -1.0f, lastY = -1.0f; // cursor in the last event
+
+// replaying
+static std::vector<InputEvent> events;
+static size_t nextEvent = 0;
+static uint32_t replayFrames = 0;
+
+bool InputRecordOpen(const char* path) {
+	InputRecordClose();
+	recordFile = fopen(path, "wb");
+	if (recordFile == NULL) {
+		fprintf(stderr, "ERROR: Could not open %s\n", path);
+		return false;
+	}
+	InputHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, InputMagic, sizeof(header.magic));
+	header.major = InputMajorVersion;
+	header.minor = InputMinorVersion;
+	header.eventSize = sizeof(InputEvent);
+	if (fwrite(&header, sizeof(header), 1, recordFile) != 1) {
+		fprintf(stderr, "ERROR: Could not write %s\n", path);
+		fclose(recordFile);
+		recordFile = NULL;
+		return false;
+	}
+	recordStart = std::chrono::steady_clock::now();
+	recordFrame = 0;
+	lastX = lastY = -1.0f;
+	return true;
+}
+
+void InputRecord(int type, int code, int action, double x, double y) {
+	if (recordFile == NULL) {
+		return;
+	}
+	InputEvent e;
+	memset(&e, 0, sizeof(e));
+	e.frame = recordFrame;
+	e.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - recordStart).count();
+	e.type = (uint8_t)type;
+	e.action = (uint8_t)action;
+	e.code = (int16_t)code;
+	e.x = (float)x;
+	e.y = (float)y;
+	// the file is buffered, so this is a copy most of the time
+	fwrite(&e, sizeof(e), 1, recordFile);
+	lastX = e.x;
+	lastY = e.y;
+}
+
+void InputRecordCursor(double x, double y) {
+	if ((float)x != lastX || (float)y != lastY) {
+		InputRecord(InputCursor, 0, 0, x, y);
+	}
+}
+
+void InputRecordFrame(void) {
+	recordFrame++;
+}
+
+void InputRecordClose(void) {
+	if (recordFile == NULL) {
+		return;
+	}
+	InputRecord(InputEnd, 0, 0, lastX, lastY);
+	if (ferror(recordFile) || fclose(recordFile) != 0) {
+		fprintf(stderr, "ERROR: Could not write the input recording\n");
+	}
+	recordFile = NULL;
+}
+
+bool InputReplayOpen(const char* path) {
+	InputReplayClose();
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		fprintf(stderr, "ERROR: Could not open %s\n", path);
+		return false;
+	}
+	InputHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, InputMagic, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "ERROR: %s is not an input recording\n", path);
+		fclose(f);
+		return false;
+	}
+	if (header.major != InputMajorVersion || header.eventSize == 0) {
+		fprintf(stderr, "ERROR: %s is input version %u.%u, this build reads %u.x\n", path, header.major, header.minor, InputMajorVersion);
+		fclose(f);
+		return false;
+	}
+	std::vector<char> record(header.eventSize);
+	while (fread(&record[0], header.eventSize, 1, f) == 1) {
+		InputEvent e;
+		memset(&e, 0, sizeof(e));
+		memcpy(&e, &record[0], std::min<size_t>(header.eventSize, sizeof(e)));
+		events.push_back(e);
+	}
+	fclose(f);
+	// a recording cut off before its end event lasts up to its last event
+	replayFrames = events.empty() ? 0 : events.back().frame + (events.back().type == InputEnd ? 0 : 1);
+	return true;
+}
+
+uint32_t InputReplayFrames(void) {
+	return replayFrames;
+}
+
+const InputEvent* InputReplayEvent(uint32_t frame) {
+	while (nextEvent < events.size() && events[nextEvent].frame <= frame) {
+		const InputEvent* e = &events[nextEvent++];
+		if (e->type != InputEnd) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+void InputReplayClose(void) {
+	events.clear();
+	nextEvent = 0;
+	replayFrames = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef INPUT_HPP
+#define INPUT_HPP
+
+// Input recordings: the mouse buttons, keys and cursor of an interactive session,
+// each tagged with the frame that handles it, so the session can be fed back
+// through the same callbacks frame for frame, e.g. in the headless benchmark.
+// A replay starts from the scene the recording did. No GLFW in here.
+//
+// Layout, little-endian: an InputHeader, then InputEvent records to the end of
+// the file, in the order they happened. Readers read records up to their own
+// size, so later minor versions can grow them; a new major version is refused.
+
+#include <stddef.h>
+#include <stdint.h>
+
+const uint32_t InputMajorVersion = 1;
+const uint32_t InputMinorVersion = 0;
+
+enum InputEventType {
+	InputCursor = 1, // the cursor moved to x, y
+	InputMouseButton = 2, // code is the button
+	InputKey = 3, // code is the key
+	InputEnd = 4, // the recording stopped before this frame
+};
+
+struct InputHeader {
+	char magic[8]; // "HW1BINP" and a 0
+	uint32_t major, minor;
+	uint32_t eventSize; // bytes per record
+};
+
+struct InputEvent {
+	uint32_t frame; // handled at the start of this frame, counted from 0
+	float time; // seconds since the recording started
+	uint8_t type; // InputEventType
+	uint8_t action; // press, release or repeat, as GLFW numbers them
+	int16_t code;
+	float x, y; // cursor in window pixels, (0,0) at the top left
+};
+
+// start writing a recording to path; false (with a message on stderr) on failure
+bool InputRecordOpen(const char* path);
+// log an event for the frame being recorded; nothing while not recording
+void InputRecord(int type, int code, int action, double x, double y);
+// log the cursor, but only if it moved since the last event
+void InputRecordCursor(double x, double y);
+// events from here on are handled in the next frame
+void InputRecordFrame(void);
+// write the end of the recording and close it
+void InputRecordClose(void);
+
+// read a whole recording; false (with a message on stderr) if it is not one
+bool InputReplayOpen(const char* path);
+// frames the recording covers
+uint32_t InputReplayFrames(void);
+// the next event handled by frame, or NULL once there are no more for it
+const InputEvent* InputReplayEvent(uint32_t frame);
+void InputReplayClose(void);
+
+#endif
@@ -0,0 +1,121 @@
+// Micro-benchmark for the CPU picking grid in pickgrid.cpp. Needs no window or GPU.
+//
+// Build:  cmake -S . -B build && cmake --build build --target pickbench
+// Usage:  ./pickbench [max control points, default 1000000]
+//
+// Sweeps the number of control points by powers of ten from 10, scattered over
+// a 1024x768 window, and reports the cost of building the grid, of moving one
+// dragged point and of a nearest-point click query, next to a linear scan.
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include "pickgrid.hpp"
+
+const int width = 1024, height = 768;
+const float radius = 5.0f;
+// window x = (x + 1) * width / 2, y = (1 - y) * height / 2
+const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+float rnd() {
+	return rand() / float(RAND_MAX);
+}
+
+double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// keeps the optimiser from dropping the calls
+volatile int sink;
+
+// run op(i) for i = 0, 1, ... until at least minTime has passed, return seconds per call
+template <typename F>
+double timeOp(F op, double minTime) {
+	int reps = 0;
+	double start = now();
+	double elapsed = 0.0;
+	do {
+		sink = op(reps);
+		reps++;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	return elapsed / reps;
+}
+
+// what picking without an index costs: every point, every click
+int linearNearest(const PickGrid& g, float px, float py) {
+	int best = -1;
+	float bestDist = radius * radius;
+	for (int k = 0; k < (int)g.x.size(); k++) {
+		float dx = g.x[k] - px;
+		float dy = g.y[k] - py;
+		float d = dx * dx + dy * dy;
+		if (d <= bestDist) {
+			best = k;
+			bestDist = d;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	int maxPoints = 1000000;
+	if (argc > 1) {
+		maxPoints = atoi(argv[1]);
+	}
+	const double minTime = 0.2;
+	const int clicks = 1024;
+
+	std::vector<Vertex> poly;
+	std::vector<float> cursor(2 * clicks);
+	PickGrid grid;
+
+	printf("%10s %14s %12s %12s %12s %9s %10s\n", "points", "build ns/pt", "move ns", "query ns", "linear ns", "speedup", "mismatch");
+	for (int n = 10; n <= maxPoints; n *= 10) {
+		poly.resize(n);
+		for (int i = 0; i < n; i++) {
+			float coords[] = { 2 * rnd() - 1, 2 * rnd() - 1, 0.0f, 1.0f };
+			poly[i].SetCoords(coords);
+		}
+		// half the clicks land on a point, half anywhere
+		for (int c = 0; c < clicks; c++) {
+			int k = rand() % n;
+			bool near = c % 2 == 0;
+			cursor[2 * c] = near ? (poly[k].XYZW[0] + 1) * 0.5f * width + 2 * rnd() : rnd() * width;
+			cursor[2 * c + 1] = near ? (1 - poly[k].XYZW[1]) * 0.5f * height + 2 * rnd() : rnd() * height;
+		}
+
+		double build = timeOp([&](int) { PickGridBuild(grid, &poly[0], n, identity, width, height, radius); return grid.head[0]; }, minTime);
+		double move = timeOp([&](int i) {
+			int k = (int)((i * 7919LL) % n);
+			poly[k].XYZW[0] = 2 * rnd() - 1;
+			PickGridMove(grid, &poly[0], k);
+			return grid.cell[k];
+		}, minTime);
+		double query = timeOp([&](int i) { int c = i % clicks; return PickGridNearest(grid, cursor[2 * c], cursor[2 * c + 1], radius); }, minTime);
+		double linear = timeOp([&](int i) { int c = i % clicks; return linearNearest(grid, cursor[2 * c], cursor[2 * c + 1]); }, minTime);
+
+		// both must find a point at the same distance, ties may pick different ones
+		int mismatch = 0;
+		for (int c = 0; c < clicks; c++) {
+			int a = PickGridNearest(grid, cursor[2 * c], cursor[2 * c + 1], radius);
+			int b = linearNearest(grid, cursor[2 * c], cursor[2 * c + 1]);
+			if ((a < 0) != (b < 0)) {
+				mismatch++;
+			}
+			else if (a >= 0) {
+				float da = (grid.x[a] - cursor[2 * c]) * (grid.x[a] - cursor[2 * c]) + (grid.y[a] - cursor[2 * c + 1]) * (grid.y[a] - cursor[2 * c + 1]);
+				float db = (grid.x[b] - cursor[2 * c]) * (grid.x[b] - cursor[2 * c]) + (grid.y[b] - cursor[2 * c + 1]) * (grid.y[b] - cursor[2 * c + 1]);
+				mismatch += da != db;
+			}
+		}
+
+		printf("%10d %14.3f %12.1f %12.1f %12.1f %8.1fx %10d\n", n, build * 1e9 / n, move * 1e9, query * 1e9, linear * 1e9, linear / query, mismatch);
+	}
+
+	return 0;
+}
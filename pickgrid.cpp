@@ -0,0 +1,116 @@
+#include "pickgrid.hpp"
+
+// window position of point k; false if it is behind the camera
+static bool project(PickGrid& g, const Vertex* v, int k) {
+	const float* m = g.mvp;
+	const float* p = v[k].XYZW;
+	float cx = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12] * p[3];
+	float cy = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13] * p[3];
+	float cz = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14] * p[3];
+	float cw = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15] * p[3];
+	if (!(cw > 0.0f)) {
+		return false;
+	}
+	g.x[k] = (cx / cw + 1.0f) * 0.5f * g.width;
+	g.y[k] = (1.0f - cy / cw) * 0.5f * g.height;
+	g.depth[k] = cz / cw;
+	return true;
+}
+
+// column or row of a window coordinate; points off screen go to the border cells
+static int clampCell(float c, float cellSize, int cells) {
+	float f = c / cellSize;
+	if (!(f >= 0.0f)) {
+		return 0;
+	}
+	if (f >= cells) {
+		return cells - 1;
+	}
+	return (int)f;
+}
+
+static void insert(PickGrid& g, int k) {
+	int c = g.cell[k];
+	g.prev[k] = -1;
+	g.next[k] = g.head[c];
+	if (g.head[c] >= 0) {
+		g.prev[g.head[c]] = k;
+	}
+	g.head[c] = k;
+}
+
+static void unlink(PickGrid& g, int k) {
+	int c = g.cell[k];
+	if (g.prev[k] >= 0) {
+		g.next[g.prev[k]] = g.next[k];
+	}
+	else {
+		g.head[c] = g.next[k];
+	}
+	if (g.next[k] >= 0) {
+		g.prev[g.next[k]] = g.prev[k];
+	}
+}
+
+// project point k and put it in its cell
+static void place(PickGrid& g, const Vertex* v, int k) {
+	if (!project(g, v, k)) {
+		g.cell[k] = -1;
+		return;
+	}
+	g.cell[k] = clampCell(g.y[k], g.cellSize, g.rows) * g.cols + clampCell(g.x[k], g.cellSize, g.cols);
+	insert(g, k);
+}
+
+void PickGridBuild(PickGrid& g, const Vertex* v, int n, const float* mvp, int width, int height, float cellSize) {
+	g.width = width;
+	g.height = height;
+	g.cellSize = cellSize;
+	g.cols = (int)(width / cellSize) + 1;
+	g.rows = (int)(height / cellSize) + 1;
+	for (int i = 0; i < 16; i++) {
+		g.mvp[i] = mvp[i];
+	}
+	g.head.assign(g.cols * g.rows, -1);
+	g.next.resize(n);
+	g.prev.resize(n);
+	g.cell.resize(n);
+	g.x.resize(n);
+	g.y.resize(n);
+	g.depth.resize(n);
+	for (int k = 0; k < n; k++) {
+		place(g, v, k);
+	}
+}
+
+void PickGridMove(PickGrid& g, const Vertex* v, int k) {
+	if (g.cell[k] >= 0) {
+		unlink(g, k);
+	}
+	place(g, v, k);
+}
+
+int PickGridNearest(const PickGrid& g, float px, float py, float radius) {
+	int c0 = clampCell(px - radius, g.cellSize, g.cols);
+	int c1 = clampCell(px + radius, g.cellSize, g.cols);
+	int r0 = clampCell(py - radius, g.cellSize, g.rows);
+	int r1 = clampCell(py + radius, g.cellSize, g.rows);
+	int best = -1;
+	float bestDist = radius * radius;
+	float bestDepth = 0.0f;
+	for (int r = r0; r <= r1; r++) {
+		for (int c = c0; c <= c1; c++) {
+			for (int k = g.head[r * g.cols + c]; k >= 0; k = g.next[k]) {
+				float dx = g.x[k] - px;
+				float dy = g.y[k] - py;
+				float d = dx * dx + dy * dy;
+				if (d < bestDist || (d == bestDist && (best < 0 || g.depth[k] < bestDepth))) {
+					best = k;
+					bestDist = d;
+					bestDepth = g.depth[k];
+				}
+			}
+		}
+	}
+	return best;
+}
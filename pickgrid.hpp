@@ -0,0 +1,31 @@
+#ifndef PICKGRID_HPP
+#define PICKGRID_HPP
+
+// Screen-space uniform grid over the projected control points, so a click is
+// resolved on the CPU instead of rendering an ID buffer and reading it back.
+// Every cell keeps a doubly linked list of its points, so a dragged point
+// changes cell in constant time. No OpenGL in here.
+
+#include <vector>
+
+#include "curves.hpp"
+
+struct PickGrid {
+	int width, height; // window size in pixels
+	float cellSize; // in pixels
+	int cols, rows;
+	float mvp[16]; // column-major, as glm stores it
+	std::vector<int> head; // first point of each cell, -1 if empty
+	std::vector<int> next, prev; // neighbours of each point in its cell, -1 at the ends
+	std::vector<int> cell; // cell of each point, -1 if it is behind the camera
+	std::vector<float> x, y, depth; // window position of each point, y down like the cursor
+};
+
+// project the n points of v with mvp into a width x height window and bucket them
+void PickGridBuild(PickGrid& g, const Vertex* v, int n, const float* mvp, int width, int height, float cellSize);
+// point k of v has moved
+void PickGridMove(PickGrid& g, const Vertex* v, int k);
+// nearest point within radius pixels of (px, py), the frontmost one on ties; -1 if there is none
+int PickGridNearest(const PickGrid& g, float px, float py, float radius);
+
+#endif
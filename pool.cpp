@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <mutex>
+
+#include "pool.hpp"
+
+// smallest block is 64 bytes (2 Vertex), largest 2^47
+const int MinClass = 6;
+const int NumClasses = 42;
+
+// free blocks are chained through their first word
+struct FreeBlock {
+	FreeBlock* next;
+};
+static FreeBlock* freeList[NumClasses];
+// buffers are resized from the curve workers as well as the render thread
+static std::mutex freeListLock;
+
+static int sizeClass(size_t bytes) {
+	int c = MinClass;
+	while (((size_t)1 << c) < bytes) {
+		c++;
+	}
+	return c;
+}
+
+void* PoolAlloc(size_t bytes, size_t* granted) {
+	int c = sizeClass(bytes);
+	*granted = (size_t)1 << c;
+	std::lock_guard<std::mutex> guard(freeListLock);
+	FreeBlock* block = freeList[c - MinClass];
+	if (block) {
+		freeList[c - MinClass] = block->next;
+		return block;
+	}
+	void* p = malloc(*granted);
+	if (p == NULL) {
+		fprintf(stderr, "ERROR: Could not allocate %zu bytes\n", *granted);
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+void PoolFree(void* p, size_t granted) {
+	if (p == NULL) {
+		return;
+	}
+	int c = sizeClass(granted);
+	std::lock_guard<std::mutex> guard(freeListLock);
+	FreeBlock* block = (FreeBlock*)p;
+	block->next = freeList[c - MinClass];
+	freeList[c - MinClass] = block;
+}
+
+void PoolTrim(void) {
+	std::lock_guard<std::mutex> guard(freeListLock);
+	for (int c = 0; c < NumClasses; c++) {
+		while (freeList[c]) {
+			FreeBlock* next = freeList[c]->next;
+			free(freeList[c]);
+			freeList[c] = next;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <stddef.h>
+#include <string.h>
+
+// Size-class pool allocator. Blocks are rounded up to a power of two and go
+// back onto a per-class free list when released, so buffers that grow, shrink
+// and grow again reuse the same memory instead of hitting malloc every time.
+void* PoolAlloc(size_t bytes, size_t* granted);
+void PoolFree(void* block, size_t granted);
+// return every free-listed block to the system
+void PoolTrim(void);
+
+// Growable array backed by the pool. Capacity only ever grows, so once a
+// buffer has seen its largest size, resizing it again costs nothing.
+template <typename T>
+struct GrowBuffer {
+	T* data;
+	size_t count;
+	size_t capacity;
+	bool borrowed; // data is not the pool's, see borrow()
+
+	GrowBuffer() : data(NULL), count(0), capacity(0), borrowed(false) {}
+	~GrowBuffer() {
+		if (data && !borrowed) {
+			PoolFree(data, capacity * sizeof(T));
+		}
+	}
+
+	// use the n elements at p in place; the buffer never frees them, and only
+	// copies them into the pool if it has to grow past n
+	void borrow(T* p, size_t n) {
+		if (data && !borrowed) {
+			PoolFree(data, capacity * sizeof(T));
+		}
+		data = p;
+		count = n;
+		capacity = n;
+		borrowed = true;
+	}
+
+	// make room for at least n elements, keeping the current contents
+	// returns true if the storage moved
+	bool reserve(size_t n) {
+		if (n <= capacity) {
+			return false;
+		}
+		size_t granted;
+		T* grown = (T*)PoolAlloc(n * sizeof(T), &granted);
+		if (data) {
+			memcpy(grown, data, count * sizeof(T));
+			if (!borrowed) {
+				PoolFree(data, capacity * sizeof(T));
+			}
+		}
+		data = grown;
+		capacity = granted / sizeof(T);
+		borrowed = false;
+		return true;
+	}
+	bool resize(size_t n) {
+		bool moved = reserve(n);
+		count = n;
+		return moved;
+	}
+	void push_back(const T& v) {
+		if (count == capacity) {
+			reserve(count ? 2 * count : 16);
+		}
+		data[count++] = v;
+	}
+
+	size_t bytes() const { return count * sizeof(T); }
+	T& operator[](size_t i) { return data[i]; }
+	const T& operator[](size_t i) const { return data[i]; }
+
+private:
+	GrowBuffer(const GrowBuffer&);
+	GrowBuffer& operator=(const GrowBuffer&);
+};
+
+#endif
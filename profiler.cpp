@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+// Include GLEW
+#include <GL/glew.h>
+
+#include "profiler.hpp"
+
+const char* ProfilePhaseNames[NumProfilePhases] = { "input", "create_objects", "upload", "draw", "pick", "gui", "swap" };
+
+float ProfileAverageCPU[NumProfilePhases];
+float ProfileAverageGPU[NumProfilePhases];
+
+// GPU queries are read back this many frames after they were issued
+const int QueryLatency = 4;
+const int MaxGPUScopes = 16; // per frame
+// weight of the newest frame in the averages
+const float AverageWeight = 0.1f;
+
+struct GPUScope {
+	ProfilePhase phase;
+	GLuint query;
+	double start;
+};
+// GPU scopes of one frame still waiting for their results
+struct FrameQueries {
+	long frame;
+	int count;
+	GPUScope scopes[MaxGPUScopes];
+};
+static FrameQueries pending[QueryLatency];
+static GLuint queryPool[QueryLatency * MaxGPUScopes];
+static bool gpuOpen = false;
+
+struct CPUScope {
+	ProfilePhase phase;
+	double start;
+	double children; // time spent in nested scopes
+	bool gpu;
+};
+static std::vector<CPUScope> stack;
+
+static long frame = -1;
+static double frameStart;
+static double cpuFrame[NumProfilePhases];
+static float cpuLast[NumProfilePhases];
+static float gpuLast[NumProfilePhases];
+static long gpuLastFrame = -1;
+
+// trace of the last frames, a ring indexed by frame number; phase -1 is the whole frame
+struct TraceEvent {
+	int phase;
+	bool gpu;
+	double start, duration;
+};
+struct TraceFrame {
+	long frame;
+	std::vector<TraceEvent> events;
+};
+static std::vector<TraceFrame> trace;
+
+static double epoch;
+
+static double now(void) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() - epoch;
+}
+
+static void addTraceEvent(long f, int phase, bool gpu, double start, double duration) {
+	if (trace.empty() || f < 0) {
+		return;
+	}
+	TraceFrame& t = trace[f % trace.size()];
+	if (t.frame != f) {
+		return; // already dropped
+	}
+	TraceEvent e = { phase, gpu, start, duration };
+	t.events.push_back(e);
+}
+
+// collect the results of older frames whose queries are done, oldest first, without waiting
+static void resolveQueries(void) {
+	for (int age = QueryLatency - 1; age >= 1; age--) {
+		long f = frame - age;
+		if (f < 0) {
+			continue;
+		}
+		FrameQueries& p = pending[f % QueryLatency];
+		if (p.frame != f) {
+			continue;
+		}
+		if (p.count > 0) {
+			// queries finish in order, so the last one being done means they all are
+			GLuint available = 0;
+			glGetQueryObjectuiv(p.scopes[p.count - 1].query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				return;
+			}
+		}
+		for (int i = 0; i < NumProfilePhases; i++) {
+			gpuLast[i] = 0.0f;
+		}
+		for (int i = 0; i < p.count; i++) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(p.scopes[i].query, GL_QUERY_RESULT, &ns);
+			gpuLast[p.scopes[i].phase] += ns * 1e-6f;
+			addTraceEvent(f, p.scopes[i].phase, true, p.scopes[i].start, ns * 1e-9);
+		}
+		for (int i = 0; i < NumProfilePhases; i++) {
+			ProfileAverageGPU[i] += AverageWeight * (gpuLast[i] - ProfileAverageGPU[i]);
+		}
+		gpuLastFrame = f;
+		p.frame = -1;
+	}
+}
+
+void ProfileInit(int traceFrames) {
+	epoch = 0.0;
+	epoch = now();
+	glGenQueries(QueryLatency * MaxGPUScopes, queryPool);
+	for (int i = 0; i < QueryLatency; i++) {
+		pending[i].frame = -1;
+		pending[i].count = 0;
+	}
+	trace.resize(traceFrames);
+	for (size_t i = 0; i < trace.size(); i++) {
+		trace[i].frame = -1;
+	}
+}
+
+void ProfileTerminate(void) {
+	glDeleteQueries(QueryLatency * MaxGPUScopes, queryPool);
+	trace.clear();
+}
+
+void ProfileBeginFrame(void) {
+	frame++;
+	frameStart = now();
+	for (int i = 0; i < NumProfilePhases; i++) {
+		cpuFrame[i] = 0.0;
+	}
+	resolveQueries();
+	// anything still pending in this slot is too late to wait for; its results are dropped
+	FrameQueries& p = pending[frame % QueryLatency];
+	p.frame = frame;
+	p.count = 0;
+	if (!trace.empty()) {
+		TraceFrame& t = trace[frame % trace.size()];
+		t.frame = frame;
+		t.events.clear();
+	}
+}
+
+void ProfileEndFrame(void) {
+	for (int i = 0; i < NumProfilePhases; i++) {
+		cpuLast[i] = float(1000.0 * cpuFrame[i]);
+		ProfileAverageCPU[i] += AverageWeight * (cpuLast[i] - ProfileAverageCPU[i]);
+	}
+	addTraceEvent(frame, -1, false, frameStart, now() - frameStart);
+}
+
+void ProfileBegin(ProfilePhase phase, bool gpu) {
+	CPUScope s = { phase, now(), 0.0, false };
+	FrameQueries& p = pending[(frame < 0 ? 0 : frame) % QueryLatency];
+	if (gpu && !gpuOpen && frame >= 0 && p.count < MaxGPUScopes) {
+		GPUScope& g = p.scopes[p.count];
+		g.phase = phase;
+		g.query = queryPool[(frame % QueryLatency) * MaxGPUScopes + p.count];
+		g.start = s.start;
+		glBeginQuery(GL_TIME_ELAPSED, g.query);
+		p.count++;
+		gpuOpen = true;
+		s.gpu = true;
+	}
+	stack.push_back(s);
+}
+
+void ProfileEnd(void) {
+	if (stack.empty()) {
+		return;
+	}
+	CPUScope s = stack.back();
+	stack.pop_back();
+	if (s.gpu) {
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuOpen = false;
+	}
+	double duration = now() - s.start;
+	cpuFrame[s.phase] += duration - s.children;
+	if (!stack.empty()) {
+		stack.back().children += duration;
+	}
+	addTraceEvent(frame, s.phase, false, s.start, duration);
+}
+
+float ProfileFrameCPU(ProfilePhase phase) {
+	return cpuLast[phase];
+}
+
+float ProfileFrameGPU(ProfilePhase phase) {
+	return gpuLast[phase];
+}
+
+long ProfileGPUFrame(void) {
+	return gpuLastFrame;
+}
+
+// GPU events have no GPU timestamp, so they start where the CPU issued them
+bool ProfileWriteTrace(const char* path) {
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		return false;
+	}
+	fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(out, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n");
+	fprintf(out, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}");
+	// oldest kept frame first
+	for (long f = frame - (long)trace.size() + 1; f <= frame; f++) {
+		if (f < 0) {
+			continue;
+		}
+		const TraceFrame& t = trace[f % trace.size()];
+		if (t.frame != f) {
+			continue;
+		}
+		for (size_t i = 0; i < t.events.size(); i++) {
+			const TraceEvent& e = t.events[i];
+			fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %ld}}",
+				e.phase < 0 ? "frame" : ProfilePhaseNames[e.phase], e.gpu ? 2 : 1, e.start * 1e6, e.duration * 1e6, f);
+		}
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	return true;
+}
@@ -0,0 +1,51 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// Per-phase frame timing. CPU time comes from scoped timers, GPU time from
+// GL_TIME_ELAPSED queries that are read back a few frames later, so timing
+// never stalls the pipeline. The last frames can be dumped as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev).
+
+enum ProfilePhase {
+	PhaseInput,
+	PhaseCreateObjects,
+	PhaseUpload,
+	PhaseDraw,
+	PhasePick,
+	PhaseGUI,
+	PhaseSwap,
+	NumProfilePhases
+};
+extern const char* ProfilePhaseNames[NumProfilePhases];
+
+// ms per phase, averaged over the last frames, for the GUI. CPU times are
+// exclusive: a phase nested in another is not counted in the outer one.
+extern float ProfileAverageCPU[NumProfilePhases];
+extern float ProfileAverageGPU[NumProfilePhases];
+
+// needs a current GL context; keeps the last traceFrames frames for ProfileWriteTrace(), 0 for none
+void ProfileInit(int traceFrames);
+void ProfileTerminate(void);
+void ProfileBeginFrame(void);
+void ProfileEndFrame(void);
+// scopes nest; gpu also times the scope on the GPU, unless a GPU-timed scope is already open
+void ProfileBegin(ProfilePhase phase, bool gpu);
+void ProfileEnd(void);
+
+// ms spent in phase during the last finished frame, on the CPU
+float ProfileFrameCPU(ProfilePhase phase);
+// ms spent in phase on the GPU, for the most recent frame whose queries have come back;
+// that frame's number, counting from 0, or -1 if none has yet
+float ProfileFrameGPU(ProfilePhase phase);
+long ProfileGPUFrame(void);
+
+// write the kept frames as Chrome trace JSON; false if the file cannot be written
+bool ProfileWriteTrace(const char* path);
+
+// times the enclosing block
+struct ProfileScope {
+	ProfileScope(ProfilePhase phase, bool gpu = false) { ProfileBegin(phase, gpu); }
+	~ProfileScope() { ProfileEnd(); }
+};
+
+#endif
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "scene.hpp"
+
+static const char SceneMagic[8] = "HW1BSCN";
+// sections start on a multiple of this, and the points on a multiple of
+// SceneAlign, which is a whole number of pages for any page size in use
+static const uint64_t SectionAlign = 16;
+static const uint64_t SceneAlign = 65536;
+// bytes of points the reader touches before publishing them; the first chunk
+// is read before SceneOpen() returns, so there is always something to draw
+static const size_t ReadChunk = 1 << 20;
+// more records than these are a broken file, not a scene
+static const uint64_t MaxSceneObjects = 256;
+
+static char* base = NULL; // the mapped file
+static size_t size = 0;
+static Vertex* points = NULL;
+static size_t numPoints = 0;
+static std::thread reader;
+static std::atomic<size_t> loadedPoints(0);
+static std::atomic<bool> stopping(false);
+static volatile char sink; // where touch() puts what it read, so the reads stay
+
+// The mapping itself, POSIX or Windows; both are private and writable, so edits
+// to the points stay in this process.
+#if defined(_WIN32)
+static char* mapFile(const char* path, size_t* bytes) {
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "ERROR: Could not open %s\n", path);
+		return NULL;
+	}
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length) || length.QuadPart < (LONGLONG)sizeof(SceneHeader)) {
+		fprintf(stderr, "ERROR: %s is not a scene file\n", path);
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	void* mapped = mapping ? MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) : NULL;
+	if (mapping) {
+		// the view keeps the mapping open
+		CloseHandle(mapping);
+	}
+	if (mapped == NULL) {
+		fprintf(stderr, "ERROR: Could not map %s\n", path);
+		return NULL;
+	}
+	*bytes = (size_t)length.QuadPart;
+	return (char*)mapped;
+}
+
+static void unmapFile(char* mapped, size_t) {
+	UnmapViewOfFile(mapped);
+}
+
+static size_t pageSize(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+}
+
+// the sequential scan flag the file was opened with does the read-ahead
+static void adviseSequential(char*, size_t) {
+}
+
+static void adviseWillNeed(void*, size_t) {
+}
+
+// a file that is mapped cannot be replaced here, so this fails saving over the scene in use
+static bool replaceFile(const char* from, const char* to) {
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+#else
+static char* mapFile(const char* path, size_t* bytes) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Could not open %s\n", path);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SceneHeader)) {
+		fprintf(stderr, "ERROR: %s is not a scene file\n", path);
+		close(fd);
+		return NULL;
+	}
+	void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Could not map %s\n", path);
+		return NULL;
+	}
+	*bytes = (size_t)st.st_size;
+	return (char*)mapped;
+}
+
+static void unmapFile(char* mapped, size_t bytes) {
+	munmap(mapped, bytes);
+}
+
+static size_t pageSize(void) {
+	return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void adviseSequential(char* mapped, size_t bytes) {
+	madvise(mapped, bytes, MADV_SEQUENTIAL);
+}
+
+static void adviseWillNeed(void* from, size_t bytes) {
+	madvise(from, bytes, MADV_WILLNEED);
+}
+
+static bool replaceFile(const char* from, const char* to) {
+	return rename(from, to) == 0;
+}
+#endif
+
+static uint64_t alignUp(uint64_t x, uint64_t align) {
+	return (x + align - 1) / align * align;
+}
+
+static bool writeZeros(FILE* f, uint64_t bytes) {
+	static const char zeros[256] = { 0 };
+	while (bytes > 0) {
+		size_t n = (size_t)std::min<uint64_t>(bytes, sizeof(zeros));
+		if (fwrite(zeros, 1, n, f) != n) {
+			return false;
+		}
+		bytes -= n;
+	}
+	return true;
+}
+
+bool SceneSave(const char* path, const Vertex* v, size_t count, const SceneCurve* curves, size_t numCurves,
+	const SceneObject* objects, size_t numObjects, const SceneView& view) {
+	SceneHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SceneMagic, sizeof(header.magic));
+	header.major = SceneMajorVersion;
+	header.minor = SceneMinorVersion;
+	const int NumSections = 4;
+	header.sections = NumSections;
+	header.sectionSize = sizeof(SceneSection);
+	SceneSection table[NumSections] = {
+		{ SectionView, sizeof(SceneView), 1, 0 },
+		{ SectionObjects, sizeof(SceneObject), numObjects, 0 },
+		{ SectionCurves, sizeof(SceneCurve), numCurves, 0 },
+		{ SectionPoints, sizeof(Vertex), count, 0 },
+	};
+	const void* data[NumSections] = { &view, objects, curves, v };
+	uint64_t offset = sizeof(header) + sizeof(table);
+	for (int i = 0; i < NumSections; i++) {
+		offset = alignUp(offset, table[i].type == SectionPoints ? SceneAlign : SectionAlign);
+		table[i].offset = offset;
+		offset += table[i].count * table[i].stride;
+	}
+
+	std::string tmp = std::string(path) + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wb");
+	if (f == NULL) {
+		fprintf(stderr, "ERROR: Could not open %s\n", tmp.c_str());
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(table, sizeof(table), 1, f) == 1;
+	uint64_t written = sizeof(header) + sizeof(table);
+	for (int i = 0; i < NumSections && ok; i++) {
+		ok = writeZeros(f, table[i].offset - written);
+		if (ok && table[i].count > 0) {
+			ok = fwrite(data[i], table[i].stride, (size_t)table[i].count, f) == table[i].count;
+		}
+		written = table[i].offset + table[i].count * table[i].stride;
+	}
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		fprintf(stderr, "ERROR: Could not write %s\n", tmp.c_str());
+		remove(tmp.c_str());
+		return false;
+	}
+	if (!replaceFile(tmp.c_str(), path)) {
+		fprintf(stderr, "ERROR: Could not rename %s to %s\n", tmp.c_str(), path);
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+// touch every page of the points in [begin, end) bytes, so they are in memory
+static void touch(size_t begin, size_t end) {
+	size_t page = pageSize();
+	const volatile char* p = (const char*)points;
+	char sum = 0;
+	for (size_t b = begin; b < end; b += page) {
+		sum += p[b];
+	}
+	if (end > begin) {
+		sum += p[end - 1];
+	}
+	sink = sum;
+}
+
+// ask the kernel to start reading [begin, end) bytes of the points in
+static void willNeed(size_t begin, size_t end) {
+	size_t page = pageSize();
+	uintptr_t from = ((uintptr_t)points + begin) / page * page;
+	uintptr_t to = (uintptr_t)points + end;
+	if (to > from) {
+		adviseWillNeed((void*)from, to - from);
+	}
+}
+
+// a chunk at a time, keeping the next one on its way from the disk
+static void readPoints(size_t from) {
+	size_t bytes = numPoints * sizeof(Vertex);
+	for (size_t chunk = from; chunk < bytes && !stopping; chunk += ReadChunk) {
+		size_t end = std::min(chunk + ReadChunk, bytes);
+		willNeed(end, std::min(end + ReadChunk, bytes));
+		touch(chunk, end);
+		// a point is only published once all of it is in, and is never read again
+		// here, so the render thread is free to edit it
+		loadedPoints.store(end / sizeof(Vertex));
+	}
+}
+
+// entry i of the section table
+static void section(const SceneHeader& header, uint32_t i, SceneSection* out) {
+	memcpy(out, base + sizeof(header) + (size_t)i * header.sectionSize, sizeof(*out));
+}
+
+bool SceneOpen(const char* path, SceneView* view, std::vector<SceneCurve>* curves, std::vector<SceneObject>* objects) {
+	SceneClose();
+	curves->clear();
+	objects->clear();
+	base = mapFile(path, &size);
+	if (base == NULL) {
+		return false;
+	}
+
+	SceneHeader header;
+	memcpy(&header, base, sizeof(header));
+	if (memcmp(header.magic, SceneMagic, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "ERROR: %s is not a scene file\n", path);
+		SceneClose();
+		return false;
+	}
+	if (header.major != SceneMajorVersion) {
+		fprintf(stderr, "ERROR: %s is scene version %u.%u, this build reads %u.x\n", path, header.major, header.minor, SceneMajorVersion);
+		SceneClose();
+		return false;
+	}
+	if (header.sectionSize < sizeof(SceneSection) || header.sections > (size - sizeof(header)) / header.sectionSize) {
+		fprintf(stderr, "ERROR: %s has a broken section table\n", path);
+		SceneClose();
+		return false;
+	}
+	for (uint32_t i = 0; i < header.sections; i++) {
+		SceneSection s;
+		section(header, i, &s);
+		if (s.offset > size || (s.stride > 0 && s.count > (size - s.offset) / s.stride)) {
+			fprintf(stderr, "ERROR: %s is cut short\n", path);
+			SceneClose();
+			return false;
+		}
+		// a record of no bytes fits any count; the sections read here all have some
+		bool known = s.type == SectionPoints || s.type == SectionObjects || s.type == SectionView || s.type == SectionCurves;
+		if (known && s.count > 0 && s.stride == 0) {
+			fprintf(stderr, "ERROR: %s has a section of empty records\n", path);
+			SceneClose();
+			return false;
+		}
+		// each curve has points of its own, so there are never more curves than fit in the file as points
+		if ((s.type == SectionObjects && s.count > MaxSceneObjects) || (s.type == SectionCurves && s.count > size / sizeof(Vertex))) {
+			fprintf(stderr, "ERROR: %s has %llu records in a section of type %u, too many to be a scene\n", path, (unsigned long long)s.count, s.type);
+			SceneClose();
+			return false;
+		}
+		const char* data = base + s.offset;
+		if (s.type == SectionPoints) {
+			if (s.stride != sizeof(Vertex) || s.offset % sizeof(float) != 0) {
+				fprintf(stderr, "ERROR: %s has points of %u bytes, this build uses %u\n", path, s.stride, (unsigned int)sizeof(Vertex));
+				SceneClose();
+				return false;
+			}
+			points = (Vertex*)data;
+			numPoints = (size_t)s.count;
+		}
+		else if (s.type == SectionObjects) {
+			for (uint64_t k = 0; k < s.count; k++) {
+				SceneObject object;
+				memset(&object, 0, sizeof(object));
+				memcpy(&object, data + k * s.stride, std::min<size_t>(s.stride, sizeof(object)));
+				objects->push_back(object);
+			}
+		}
+		else if (s.type == SectionCurves) {
+			for (uint64_t k = 0; k < s.count; k++) {
+				SceneCurve curve;
+				memset(&curve, 0, sizeof(curve));
+				memcpy(&curve, data + k * s.stride, std::min<size_t>(s.stride, sizeof(curve)));
+				curves->push_back(curve);
+			}
+		}
+		else if (s.type == SectionView && s.count > 0) {
+			memcpy(view, data, std::min<size_t>(s.stride, sizeof(*view)));
+		}
+	}
+	if (points == NULL || numPoints == 0) {
+		fprintf(stderr, "ERROR: %s has no control points\n", path);
+		SceneClose();
+		return false;
+	}
+
+	size_t bytes = numPoints * sizeof(Vertex);
+	adviseSequential(base, size);
+	willNeed(0, std::min(2 * ReadChunk, bytes));
+	size_t first = std::min(ReadChunk, bytes);
+	touch(0, first);
+	loadedPoints.store(first / sizeof(Vertex));
+	stopping = false;
+	if (first < bytes) {
+		reader = std::thread(readPoints, first);
+	}
+	return true;
+}
+
+Vertex* ScenePoints(size_t* count) {
+	*count = numPoints;
+	return points;
+}
+
+size_t SceneLoadedPoints(void) {
+	return loadedPoints.load();
+}
+
+void SceneClose(void) {
+	stopping = true;
+	if (reader.joinable()) {
+		reader.join();
+	}
+	if (base) {
+		unmapFile(base, size);
+	}
+	base = NULL;
+	size = 0;
+	points = NULL;
+	numPoints = 0;
+	loadedPoints.store(0);
+}
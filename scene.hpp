@@ -0,0 +1,83 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+// Binary scene files: the control points, the curves they make up, the colour of
+// each derived object and the view state. A file is memory-mapped copy-on-write, so its control points
+// are used, and uploaded, straight from the mapped pages, and editing them never
+// changes the file. A background thread reads the points in ahead of use, so a
+// large file can be drawn while it is still coming off the disk. No OpenGL in here.
+//
+// Layout, little-endian: a SceneHeader, its table of SceneSections, then the
+// sections; the points start on a page boundary. Readers skip section types they do
+// not know and read records up to their own size, so later minor versions can
+// add sections and grow records; a new major version is refused.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "curves.hpp"
+
+const uint32_t SceneMajorVersion = 1;
+const uint32_t SceneMinorVersion = 1;
+
+enum SceneSectionType {
+	SectionPoints = 1, // Vertex records, read in place, so the stride must be sizeof(Vertex)
+	SectionObjects = 2, // SceneObject records
+	SectionView = 3, // one SceneView
+	SectionCurves = 4, // SceneCurve records, since 1.1; a file without them is one curve
+};
+
+struct SceneHeader {
+	char magic[8]; // "HW1BSCN" and a 0
+	uint32_t major, minor;
+	uint32_t sections; // entries in the table right after the header
+	uint32_t sectionSize; // bytes per entry
+};
+
+struct SceneSection {
+	uint32_t type;
+	uint32_t stride; // bytes per record
+	uint64_t count; // records
+	uint64_t offset; // from the start of the file
+};
+
+// one closed curve: control points [first, first + count)
+struct SceneCurve {
+	uint32_t first, count;
+};
+
+// colour of one derived object
+struct SceneObject {
+	uint32_t id;
+	float rgba[4];
+};
+
+// what is drawn, and how
+struct SceneView {
+	int32_t pressed, count; // curve shown, and subdivision level
+	int32_t loop, splitView, quadView, gpuCurves;
+	int32_t directSubdivision, directLevel, directLimit;
+	int32_t curveSamples;
+	float curveTolerance, loopSpeed;
+};
+
+// write a scene to path; it goes to a temporary file that is renamed over path,
+// so a mapped file, even the one being replaced, never changes under its reader.
+// false (with a message on stderr) on failure
+bool SceneSave(const char* path, const Vertex* points, size_t count, const SceneCurve* curves, size_t numCurves,
+	const SceneObject* objects, size_t numObjects, const SceneView& view);
+
+// map a scene and start reading its points in; false (with a message on stderr)
+// if it is not a scene this build reads. A SectionView section overwrites *view,
+// as much of it as the file has; curves and objects get the file's records
+bool SceneOpen(const char* path, SceneView* view, std::vector<SceneCurve>* curves, std::vector<SceneObject>* objects);
+// every control point in the file, writable copy-on-write
+Vertex* ScenePoints(size_t* count);
+// how many of them, from the first, have been read in; at least a first chunk
+// once SceneOpen() has returned, and all of them once the reader is done
+size_t SceneLoadedPoints(void);
+// stop the reader and unmap the file; the points must no longer be used
+void SceneClose(void);
+
+#endif
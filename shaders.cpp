@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "shaders.hpp"
+
+static bool readFile(const char* path, std::string* text) {
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		fprintf(stderr, "ERROR: Could not open %s\n", path);
+		return false;
+	}
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		text->append(buffer, n);
+	}
+	fclose(f);
+	return true;
+}
+
+// the source with defines after its #version line; #line keeps the
+// compiler's line numbers those of the file
+static std::string withDefines(const std::string& source, const char* defines) {
+	size_t body = 0;
+	if (source.compare(0, 8, "#version") == 0) {
+		body = source.find('\n');
+		body = body == std::string::npos ? source.size() : body + 1;
+	}
+	char line[32];
+	snprintf(line, sizeof(line), "#line %d\n", body > 0 ? 2 : 1);
+	return source.substr(0, body) + defines + line + source.substr(body);
+}
+
+static GLuint compile(GLenum type, const char* path, const char* defines) {
+	std::string source;
+	if (!readFile(path, &source)) {
+		return 0;
+	}
+	source = withDefines(source, defines);
+	GLuint shader = glCreateShader(type);
+	const char* text = source.c_str();
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+	GLint ok, length;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> log(length + 1);
+		glGetShaderInfoLog(shader, length, NULL, &log[0]);
+		fprintf(stderr, "ERROR: Could not compile %s with\n%s%s\n", path, defines, &log[0]);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+GLuint LoadShaderVariant(const char* vertexPath, const char* fragmentPath, const char* defines) {
+	GLuint vertex = compile(GL_VERTEX_SHADER, vertexPath, defines);
+	GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentPath, defines);
+	if (vertex == 0 || fragment == 0) {
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return 0;
+	}
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+	// the program keeps what it needs of them
+	glDetachShader(program, vertex);
+	glDetachShader(program, fragment);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	GLint ok, length;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> log(length + 1);
+		glGetProgramInfoLog(program, length, NULL, &log[0]);
+		fprintf(stderr, "ERROR: Could not link %s and %s with\n%s%s\n", vertexPath, fragmentPath, defines, &log[0]);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
@@ -0,0 +1,13 @@
+#ifndef SHADERS_HPP
+#define SHADERS_HPP
+
+// Shader variants: one pair of source files compiled into several programs,
+// each with its own #define lines put in right after the #version line, so the
+// shaders can #ifdef away what a variant does not need. Needs a current GL context.
+
+#include <GL/glew.h>
+
+// compile and link a variant; 0 (with the compiler's log on stderr) on failure
+GLuint LoadShaderVariant(const char* vertexPath, const char* fragmentPath, const char* defines);
+
+#endif
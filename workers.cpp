@@ -0,0 +1,82 @@
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "workers.hpp"
+
+static std::vector<std::thread> threads;
+static std::deque<std::function<void()> > queue;
+static std::mutex lock;
+static std::condition_variable wake; // a task was queued, or the pool is stopping
+static std::condition_variable idle; // the last outstanding task finished
+static int outstanding = 0; // queued or running
+static bool stopping = false;
+
+static void workerLoop(void) {
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		while (queue.empty() && !stopping) {
+			wake.wait(guard);
+		}
+		if (queue.empty()) {
+			return;
+		}
+		std::function<void()> task = queue.front();
+		queue.pop_front();
+		guard.unlock();
+		task();
+		guard.lock();
+		if (--outstanding == 0) {
+			idle.notify_all();
+		}
+	}
+}
+
+void WorkersInit(int count) {
+	if (count <= 0) {
+		count = (int)std::thread::hardware_concurrency() - 1;
+		if (count < 1) {
+			count = 1;
+		}
+	}
+	stopping = false;
+	for (int i = 0; i < count; i++) {
+		threads.push_back(std::thread(workerLoop));
+	}
+}
+
+void WorkersTerminate(void) {
+	WorkersWait();
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+	threads.clear();
+}
+
+void WorkersSubmit(const std::function<void()>& task) {
+	if (threads.empty()) {
+		// no pool: run it here
+		task();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push_back(task);
+		outstanding++;
+	}
+	wake.notify_one();
+}
+
+void WorkersWait(void) {
+	std::unique_lock<std::mutex> guard(lock);
+	while (outstanding > 0) {
+		idle.wait(guard);
+	}
+}
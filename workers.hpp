@@ -0,0 +1,17 @@
+#ifndef WORKERS_HPP
+#define WORKERS_HPP
+
+// Small fixed pool of worker threads for the curve kernels. Tasks are plain
+// functions run in any order; WorkersWait() is the only synchronisation.
+
+#include <functional>
+
+// start the pool; threads 0 means one per hardware thread, less the render thread, at least 1
+void WorkersInit(int threads);
+// wait for the queued tasks, then stop and join every worker
+void WorkersTerminate(void);
+void WorkersSubmit(const std::function<void()>& task);
+// until every task submitted so far has finished
+void WorkersWait(void);
+
+#endif